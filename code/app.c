@@ -1,3 +1,4 @@
+#define _GNU_SOURCE         // pthread_setaffinity_np, CPU_SET
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,15 +7,41 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <stddef.h>
+#include <sys/ioctl.h>
+#include <poll.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sched.h>
+#include <linux/rtc.h>
+
+#include "sensorlog.h"
+#include "smartclock_shm.h"
+#include "sensorhub.h"
 
 #define DEVICE_DS1302   "/dev/ds1302"
-#define DEVICE_ROTARY   "/dev/rotary"
+#define DEVICE_ROTARY   "/dev/rotary0"
 #define DEVICE_OLED     "/dev/oled"
 #define DEVICE_DHT11    "/dev/dht11"
 
+// DS1302 배터리 백업 RAM (nvmem)
+#define NVRAM_PATH      "/sys/bus/nvmem/devices/ds1302_ram/nvmem"
+#define NVRAM_MAGIC     0xC5
+#define NVRAM_VERSION   1
+
 typedef enum {
     SCREEN_NORMAL,
-    SCREEN_TIME_EDIT
+    SCREEN_TIME_EDIT,
+    SCREEN_MESSAGE          // 렌더러 전용: 시간 저장 결과 표시 중
 } screen_mode_t;
 
 typedef enum {
@@ -37,7 +64,8 @@ typedef struct {
 } time_data_t;
 
 typedef struct {
-    char ds1302_data[64];
+    time_data_t now;        // DS1302 현재 시간 (year: 0~99)
+    int time_valid;
     char dht11_data[64];
     int temp;
     int humi;
@@ -45,18 +73,94 @@ typedef struct {
     edit_field_t edit_field;
     time_data_t edit_time;
     int update_display;
+    int redraw_input;       // 입력으로 인한 갱신: 프레임 간격을 기다리지 않음
+    int message_hold;       // 시간 저장 결과 표시 중
+    int message_error;      // 저장 실패 ("Save Failed!")
+    uint64_t hold_until_ns; // message_hold 해제 시각
+    int rtc_pending;        // 장치 워커가 rtc_commit 을 DS1302 에 써야 함
+    time_data_t rtc_commit;
+    uint64_t input_ts_ns;   // 아직 화면에 반영되지 않은 가장 오래된 로터리 이벤트 (커널 ts)
     int running;
 } shared_data_t;
 
+// 콜드 스타트 시 바로 보여줄 마지막 값 (31 바이트 이하)
+typedef struct __attribute__((packed)) {
+    unsigned char magic;
+    unsigned char version;
+    signed char temp;
+    unsigned char humi;
+    unsigned char checksum;
+} nvram_state_t;
+
 shared_data_t shared = {0};
 pthread_mutex_t data_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * shared 의 seqlock. 쓰는 쪽은 data_mutex 로 서로 직렬화하고 (메모리 갱신만, I/O 없음)
+ * 그 사이 shared_seq 를 홀수로 만든다. 렌더러는 잠금 없이 shared_snapshot() 으로
+ * 일관된 복사본을 얻은 뒤 OLED 에 쓴다.
+ */
+unsigned int shared_seq;
+pthread_cond_t redraw_cond;     // CLOCK_MONOTONIC, main 에서 초기화
+
 int ds1302_fd = -1;
 int rotary_fd = -1;
 int oled_fd = -1;
 int dht11_fd = -1;
 
-pthread_t thread_ds1302, thread_dht11, thread_rotary, thread_oled;
+// /dev/sensorhub: 시간과 온습도를 레코드 하나로 받는다. --no-sensorhub 로 끈다
+int hub_enabled = 1;
+int hub_fd = -1;
+struct sensorhub_record hub_seen;   // 마지막으로 처리한 레코드 (필드별 seq 비교용)
+
+pthread_t thread_ds1302, thread_dht11, thread_rotary, thread_device, thread_metrics;
+
+// --event-loop: 스레드 4개 대신 epoll 한 스레드로 동작 (메트릭 소켓만 별도 스레드)
+int event_loop_mode = 0;
+int redraw_efd = -1;
+
+#define DHT11_PERIOD_SEC    3
+#define SAVED_MSG_MS        1000
+
+// 센서 갱신을 한 프레임으로 묶는 최소 프레임 간격
+#define MIN_FRAME_MS        50
+
+// 메트릭 (Prometheus text format). --metrics=PATH 로 바꿀 수 있다
+#define METRICS_SOCKET      "/run/smartclock.sock"
+const char* metrics_path = METRICS_SOCKET;
+int metrics_fd = -1;
+
+// 온습도 로그 (sensorlog.h). --log=PATH, --log-period=SEC, --log-sync=SEC
+#define LOG_PATH            "/var/lib/smartclock/sensors.log"
+#define LOG_CAPACITY        262144      // 4 MB, 60 초 주기로 약 6 개월
+const char* log_path = LOG_PATH;
+int log_period_sec = 60;                // 레코드 간격
+int log_sync_sec = 600;                 // msync/fsync 간격
+
+void sensorlog_sync(void);
+
+// --realtime: 입력/렌더 경로를 SCHED_FIFO 로. --rt-prio=N, --rt-cpu=N
+#define RT_STACK_PREFAULT   (64 * 1024)
+#define RT_THREAD_STACK     (RT_STACK_PREFAULT + 64 * 1024)    // 미리 건드린 부분 + libc 호출 여유
+#define JITTER_SAMPLES      500
+#define JITTER_PERIOD_US    1000
+int realtime_mode = 0;
+int rt_prio = 50;           // 로터리(입력). 렌더는 rt_prio - 1
+int rt_cpu = -1;            // 입력/렌더를 고정할 CPU (-1: 고정 안 함)
+
+// 다른 프로세스용 공유 메모리 게시 (smartclock_shm.h). --shm=NAME, --no-shm
+const char* shm_name = SMARTCLOCK_SHM_NAME;
+int shm_enabled = 1;
+smartclock_shm_t* shm_pub = NULL;
+
+// 장치 입출력 기록/재생. --record=PATH, --replay=PATH, --replay-speed=X
+const char* record_path = NULL;
+FILE* record_file = NULL;
+pthread_mutex_t record_mutex = PTHREAD_MUTEX_INITIALIZER;
+const char* replay_path = NULL;
+int replay_mode = 0;
+double replay_speed = 0;        // 0: 가상 시계로 기다림 없이, X: 기록의 X 배속으로 실시간
+uint64_t replay_clock_ns;       // 가상 시계 (replay_speed == 0)
 
 // 필드별 최소/최대값
 typedef struct {
@@ -65,6 +169,9 @@ typedef struct {
     const char* name;
 } field_limit_t;
 
+// 버튼을 누른 채 회전할 때의 스텝 크기
+#define COARSE_STEP     10
+
 const field_limit_t field_limits[] = {
     {0, 99, "Year"},    // 2000-2099
     {1, 12, "Month"},
@@ -74,86 +181,1554 @@ const field_limit_t field_limits[] = {
     {0, 59, "Second"}
 };
 
-void signal_handler(int sig) {
-    printf("\n종료 중...\n");
-    shared.running = 0;
+/*
+ * 종료 시그널 (SIGINT, SIGTERM). 핸들러 안에서는 printf/fclose/exit 등을 부를 수 없으므로
+ * 스레드를 만들기 전에 모든 스레드에서 막아 두고 main 쪽에서 받는다.
+ *  - 스레드 모드: main 이 sigwait 로 기다렸다가 스레드를 멈춘다
+ *  - 이벤트 루프 모드: signalfd 를 epoll 에 넣는다
+ * sensorlog sync, 기록 파일 닫기 등 정리는 main 이 스레드/루프가 끝난 뒤에 한다.
+ */
+sigset_t shutdown_sigs;
+
+void block_shutdown_signals(void) {
+    sigemptyset(&shutdown_sigs);
+    sigaddset(&shutdown_sigs, SIGINT);
+    sigaddset(&shutdown_sigs, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdown_sigs, NULL);
+}
+
+/*
+ * 메트릭. 카운터와 히스토그램은 __atomic 으로 갱신하므로 어느 스레드에서든 잠금 없이
+ * 기록하고, 메트릭 소켓에 연결하면 그 시점의 값을 Prometheus text format 으로 돌려준다.
+ */
+// 히스토그램 버킷 상한 (us)
+const uint64_t hist_bounds_us[] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+#define HIST_BUCKETS    (sizeof(hist_bounds_us) / sizeof(hist_bounds_us[0]))
+
+typedef struct {
+    const char* name;
+    const char* help;
+    uint64_t bucket[HIST_BUCKETS];  // 버킷별 개수 (출력할 때 누적)
+    uint64_t count;
+    uint64_t sum_ns;
+} histogram_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t fps_window_start;      // 직전 1초 구간의 시작 (ns)
+    uint64_t fps_window_frames;
+    uint64_t fps;                   // 마지막으로 끝난 1초 구간의 프레임 수
+    uint64_t rotary_events;
+    uint64_t dht11_reads;
+    uint64_t dht11_errors;
+    uint64_t ds1302_reads;
+    uint64_t ds1302_errors;
+    histogram_t input_latency;
+    histogram_t frame_time;
+    histogram_t dht11_read;
+    histogram_t ds1302_read;
+    histogram_t mutex_wait;
+} metrics_t;
+
+metrics_t metrics = {
+    .input_latency = { "smartclock_input_to_display_seconds",
+                       "Rotary event (kernel timestamp) to OLED write completion" },
+    .frame_time    = { "smartclock_frame_seconds", "Time to send one frame to the OLED" },
+    .dht11_read    = { "smartclock_dht11_read_seconds", "DHT11 read() duration" },
+    .ds1302_read   = { "smartclock_ds1302_read_seconds", "DS1302 RTC_RD_TIME duration" },
+    .mutex_wait    = { "smartclock_mutex_wait_seconds", "Time spent waiting for data_mutex" },
+};
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    
+    // 빠른 재생: 기록의 시각을 그대로 따라가는 가상 시계
+    if (replay_mode && replay_speed <= 0) {
+        return replay_clock_ns;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void metric_inc(uint64_t* counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+void hist_observe(histogram_t* h, uint64_t ns) {
+    size_t i = 0;
     
-    pthread_cancel(thread_ds1302);
-    pthread_cancel(thread_dht11);
-    pthread_cancel(thread_rotary);
-    pthread_cancel(thread_oled);
+    while (i < HIST_BUCKETS && ns > hist_bounds_us[i] * 1000) {
+        i++;
+    }
+    if (i < HIST_BUCKETS) {
+        __atomic_fetch_add(&h->bucket[i], 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum_ns, ns, __ATOMIC_RELAXED);
+}
+
+// 렌더러에서 프레임마다 호출
+void metrics_frame_done(uint64_t start_ns) {
+    uint64_t now = now_ns();
     
-    if (ds1302_fd >= 0) close(ds1302_fd);
-    if (rotary_fd >= 0) close(rotary_fd);
-    if (oled_fd >= 0) close(oled_fd);
-    if (dht11_fd >= 0) close(dht11_fd);
+    hist_observe(&metrics.frame_time, now - start_ns);
+    metric_inc(&metrics.frames);
     
-    printf("✓ 종료 완료\n");
-    exit(0);
-}
-
-// DS1302 문자열 파싱
-void parse_ds1302_time(const char* time_str, time_data_t* time_data) {
-    // "2025-12-28 14:30:25" 형식
-    sscanf(time_str, "%*d-%d-%d %d:%d:%d",
-           &time_data->month,
-           &time_data->day,
-           &time_data->hour,
-           &time_data->minute,
-           &time_data->second);
-    
-    int full_year;
-    sscanf(time_str, "%d-", &full_year);
-    time_data->year = full_year - 2000;
-}
-
-// 시간 데이터를 DS1302 형식으로 변환
-void apply_time_to_ds1302(time_data_t* time_data) {
-    char cmd[16];
-    snprintf(cmd, sizeof(cmd), "%02d%02d%02d%02d%02d%02d",
-            time_data->year,
-            time_data->month,
-            time_data->day,
-            time_data->hour,
-            time_data->minute,
-            time_data->second);
-    
-    write(ds1302_fd, cmd, 12);
+    metrics.fps_window_frames++;
+    if (now - metrics.fps_window_start >= 1000000000ULL) {
+        __atomic_store_n(&metrics.fps, metrics.fps_window_frames, __ATOMIC_RELAXED);
+        metrics.fps_window_start = now;
+        metrics.fps_window_frames = 0;
+    }
+}
+
+void metrics_print_counter(FILE* f, const char* name, const char* type,
+                           const char* help, uint64_t value) {
+    fprintf(f, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n",
+            name, help, name, type, name, (unsigned long long)value);
+}
+
+void metrics_print_hist(FILE* f, histogram_t* h) {
+    uint64_t cumulative = 0;
+    
+    fprintf(f, "# HELP %s %s\n# TYPE %s histogram\n", h->name, h->help, h->name);
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        cumulative += __atomic_load_n(&h->bucket[i], __ATOMIC_RELAXED);
+        fprintf(f, "%s_bucket{le=\"%g\"} %llu\n", h->name,
+                hist_bounds_us[i] / 1e6, (unsigned long long)cumulative);
+    }
+    fprintf(f, "%s_bucket{le=\"+Inf\"} %llu\n", h->name,
+            (unsigned long long)__atomic_load_n(&h->count, __ATOMIC_RELAXED));
+    fprintf(f, "%s_sum %.9f\n", h->name,
+            __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED) / 1e9);
+    fprintf(f, "%s_count %llu\n", h->name,
+            (unsigned long long)__atomic_load_n(&h->count, __ATOMIC_RELAXED));
+}
+
+// 메트릭 전체를 text format 으로. 반환값은 free() 해야 한다
+char* metrics_render(size_t* len) {
+    char* text = NULL;
+    FILE* f = open_memstream(&text, len);
+    uint64_t fps;
+    
+    if (f == NULL) {
+        return NULL;
+    }
+    
+    // 2 초 넘게 그린 게 없으면 0
+    fps = now_ns() - metrics.fps_window_start < 2000000000ULL ?
+          __atomic_load_n(&metrics.fps, __ATOMIC_RELAXED) : 0;
+    
+    metrics_print_counter(f, "smartclock_frames_total", "counter", "Frames sent to the OLED",
+                          __atomic_load_n(&metrics.frames, __ATOMIC_RELAXED));
+    metrics_print_counter(f, "smartclock_frames_per_second", "gauge",
+                          "Frames drawn during the last full second", fps);
+    metrics_print_counter(f, "smartclock_rotary_events_total", "counter", "Rotary events handled",
+                          __atomic_load_n(&metrics.rotary_events, __ATOMIC_RELAXED));
+    metrics_print_counter(f, "smartclock_dht11_reads_total", "counter", "DHT11 read attempts",
+                          __atomic_load_n(&metrics.dht11_reads, __ATOMIC_RELAXED));
+    metrics_print_counter(f, "smartclock_dht11_errors_total", "counter",
+                          "DHT11 reads that failed or did not parse",
+                          __atomic_load_n(&metrics.dht11_errors, __ATOMIC_RELAXED));
+    metrics_print_counter(f, "smartclock_ds1302_reads_total", "counter", "DS1302 time reads",
+                          __atomic_load_n(&metrics.ds1302_reads, __ATOMIC_RELAXED));
+    metrics_print_counter(f, "smartclock_ds1302_errors_total", "counter", "DS1302 time reads that failed",
+                          __atomic_load_n(&metrics.ds1302_errors, __ATOMIC_RELAXED));
+    metrics_print_hist(f, &metrics.input_latency);
+    metrics_print_hist(f, &metrics.frame_time);
+    metrics_print_hist(f, &metrics.dht11_read);
+    metrics_print_hist(f, &metrics.ds1302_read);
+    metrics_print_hist(f, &metrics.mutex_wait);
+    
+    fclose(f);
+    return text;
+}
+
+int metrics_listen(const char* path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    int fd;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * 연결 하나에 응답하고 닫는다. "GET " 으로 시작하는 요청이면 HTTP 응답으로 감싸고
+ * (HTTP over unix socket 을 쓰는 수집기), 아니면 본문만 보낸다 (socat 등).
+ */
+void metrics_serve(int listen_fd) {
+    char req[256];
+    size_t len = 0;
+    char* body;
+    int cfd;
+    int n = 0;
+    
+    cfd = accept(listen_fd, NULL, NULL);
+    if (cfd < 0) {
+        return;
+    }
+    
+    struct pollfd pfd = { .fd = cfd, .events = POLLIN };
+    if (poll(&pfd, 1, 10) > 0) {
+        n = recv(cfd, req, sizeof(req) - 1, MSG_DONTWAIT);
+    }
+    
+    body = metrics_render(&len);
+    if (body != NULL) {
+        if (n >= 4 && strncmp(req, "GET ", 4) == 0) {
+            char header[128];
+            int hlen = snprintf(header, sizeof(header),
+                                "HTTP/1.0 200 OK\r\n"
+                                "Content-Type: text/plain; version=0.0.4\r\n"
+                                "Content-Length: %zu\r\n\r\n", len);
+            send(cfd, header, hlen, MSG_NOSIGNAL);
+        }
+        send(cfd, body, len, MSG_NOSIGNAL);
+        free(body);
+    }
+    close(cfd);
+}
+
+/*
+ * 실시간 모드. mlockall 은 main 에서 한 번, 나머지는 각 스레드가 시작할 때 스스로 건다.
+ *  - 입력/렌더 (로터리, OLED, 이벤트 루프): SCHED_FIFO, rt_cpu 에 고정
+ *  - 디바이스 I/O (DS1302, DHT11, 메트릭): SCHED_OTHER, rt_cpu 를 피해서 실행
+ */
+void prefault_stack(void) {
+    volatile char buf[RT_STACK_PREFAULT];
+    
+    for (size_t i = 0; i < sizeof(buf); i += 4096) {
+        buf[i] = 0;
+    }
+}
+
+void rt_apply_self(const char* name, int prio) {
+    struct sched_param sp = { .sched_priority = prio };
+    int ret;
+    
+    if (!realtime_mode) {
+        return;
+    }
+    
+    ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (ret != 0) {
+        printf("⚠ [RT] %s: SCHED_FIFO %d 실패 (%s)\n", name, prio, strerror(ret));
+    }
+    
+    if (rt_cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(rt_cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+    
+    prefault_stack();
+}
+
+void rt_apply_io_self(void) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    
+    if (!realtime_mode || rt_cpu < 0 || ncpu < 2) {
+        return;
+    }
+    
+    CPU_ZERO(&set);
+    for (int i = 0; i < ncpu; i++) {
+        if (i != rt_cpu) {
+            CPU_SET(i, &set);
+        }
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*
+ * 스레드 생성. 실시간 모드에서는 mlockall(MCL_FUTURE) 뒤라 기본 스택 (8MB) 이 통째로 잠기므로
+ * prefault 하는 크기에 여유를 더한 만큼만 잡는다.
+ */
+int thread_create(pthread_t* tid, void* (*fn)(void*)) {
+    pthread_attr_t attr;
+    int ret;
+    
+    if (!realtime_mode) {
+        return pthread_create(tid, NULL, fn, NULL);
+    }
+    
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, RT_THREAD_STACK);
+    ret = pthread_create(tid, &attr, fn, NULL);
+    pthread_attr_destroy(&attr);
+    return ret;
+}
+
+int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// 1ms 주기 clock_nanosleep 의 깨어남 지연 (호출한 스레드의 정책 그대로)
+void report_jitter(const char* label) {
+    static uint64_t lat[JITTER_SAMPLES];
+    struct timespec next;
+    uint64_t sum = 0;
+    
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < JITTER_SAMPLES; i++) {
+        next.tv_nsec += JITTER_PERIOD_US * 1000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        
+        uint64_t target = (uint64_t)next.tv_sec * 1000000000ULL + next.tv_nsec;
+        lat[i] = now_ns() - target;
+        sum += lat[i];
+    }
+    
+    qsort(lat, JITTER_SAMPLES, sizeof(lat[0]), cmp_u64);
+    printf("[RT] %-11s wake-up jitter: min %llu  avg %llu  p99 %llu  max %llu us\n", label,
+           (unsigned long long)lat[0] / 1000,
+           (unsigned long long)sum / JITTER_SAMPLES / 1000,
+           (unsigned long long)lat[JITTER_SAMPLES * 99 / 100] / 1000,
+           (unsigned long long)lat[JITTER_SAMPLES - 1] / 1000);
+}
+
+void* jitter_thread(void* arg)
+{
+    rt_apply_self("jitter", rt_prio);
+    report_jitter("SCHED_FIFO");
+    return NULL;
+}
+
+// 시작할 때: 메모리 잠금 후 일반 스케줄링과 실시간 설정의 깨어남 지연을 비교해 보여준다
+void realtime_setup(void) {
+    pthread_t tid;
+    
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        perror("⚠ [RT] mlockall");
+    }
+    prefault_stack();
+    
+    printf("[RT] 실시간 모드: 입력 우선순위 %d, CPU %d\n", rt_prio, rt_cpu);
+    report_jitter("SCHED_OTHER");
+    thread_create(&tid, jitter_thread);
+    pthread_join(tid, NULL);
+}
+
+// Thread 5: 메트릭 (두 모드 모두. 느린 클라이언트가 입력/렌더 경로를 막지 않도록)
+void* metrics_thread(void* arg)
+{
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    rt_apply_io_self();
+    
+    while (shared.running) {
+        metrics_serve(metrics_fd);
+    }
+    
+    return NULL;
+}
+
+// data_mutex 잠금 + 대기 시간 기록
+void data_mutex_lock(void) {
+    uint64_t t0;
+    
+    if (pthread_mutex_trylock(&data_mutex) == 0) {
+        hist_observe(&metrics.mutex_wait, 0);
+        return;
+    }
+    t0 = now_ns();
+    pthread_mutex_lock(&data_mutex);
+    hist_observe(&metrics.mutex_wait, now_ns() - t0);
+}
+
+// data_mutex 를 이미 잡고 있을 때 shared 를 고치는 구간
+void shared_write_begin(void) {
+    __atomic_store_n(&shared_seq, shared_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void shared_write_lock(void) {
+    data_mutex_lock();
+    shared_write_begin();
+}
+
+int shm_publish_open(void) {
+    int fd = shm_open(shm_name, O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(smartclock_shm_t)) < 0) {
+        close(fd);
+        return -1;
+    }
+    shm_pub = mmap(NULL, sizeof(smartclock_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_pub == MAP_FAILED) {
+        shm_pub = NULL;
+        return -1;
+    }
+    
+    // 이전 실행이 남긴 세그먼트라도 seq 는 이어서 쓴다 (대기 중인 reader 가 깨어나도록)
+    if (shm_pub->seq & 1) {
+        shm_pub->seq++;
+    }
+    shm_pub->reading_size = sizeof(smartclock_reading_t);
+    shm_pub->version = SMARTCLOCK_SHM_VERSION;
+    __atomic_store_n(&shm_pub->magic, SMARTCLOCK_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * shared 의 값을 공유 메모리에 게시 (data_mutex 보유 상태). 읽는 쪽이 보는 값이
+ * 바뀐 경우에만 쓰고, 그때만 futex 로 대기 중인 reader 를 깨운다.
+ */
+void shm_publish(void) {
+    smartclock_reading_t r = {
+        .time_valid = shared.time_valid,
+        .year = shared.now.year + 2000,
+        .month = shared.now.month,
+        .day = shared.now.day,
+        .hour = shared.now.hour,
+        .minute = shared.now.minute,
+        .second = shared.now.second,
+        .temp = shared.temp,
+        .humi = shared.humi,
+    };
+    
+    if (shm_pub == NULL) {
+        return;
+    }
+    
+    r.update_ns = shm_pub->reading.update_ns;
+    if (memcmp(&r, &shm_pub->reading, sizeof(r)) == 0) {
+        return;
+    }
+    r.update_ns = now_ns();
+    
+    __atomic_store_n(&shm_pub->seq, shm_pub->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&shm_pub->reading, &r, sizeof(r));
+    __atomic_store_n(&shm_pub->seq, shm_pub->seq + 1, __ATOMIC_RELEASE);
+    
+    syscall(SYS_futex, &shm_pub->seq, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+void shared_write_end(void) {
+    shm_publish();
+    __atomic_store_n(&shared_seq, shared_seq + 1, __ATOMIC_RELEASE);
+}
+
+void shared_write_unlock(void) {
+    shared_write_end();
+    pthread_mutex_unlock(&data_mutex);
+}
+
+void shared_snapshot(shared_data_t* snap) {
+    unsigned int seq;
+    
+    do {
+        seq = __atomic_load_n(&shared_seq, __ATOMIC_ACQUIRE);
+        memcpy(snap, &shared, sizeof(*snap));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&shared_seq, __ATOMIC_RELAXED));
+}
+
+/*
+ * 화면 갱신 요청 (shared_write_lock 보유 상태). input 이면 OLED 스레드가 바로 그리고,
+ * 센서 갱신은 MIN_FRAME_MS 안에 들어온 것끼리 한 프레임으로 합쳐진다.
+ * 이벤트 루프 모드에서는 eventfd 로 깨운다.
+ */
+void request_redraw(int input) {
+    shared.update_display = 1;
+    if (input) {
+        shared.redraw_input = 1;
+    }
+    pthread_cond_signal(&redraw_cond);
+    
+    if (redraw_efd >= 0) {
+        uint64_t one = 1;
+        write(redraw_efd, &one, sizeof(one));
+    }
+}
+
+/*
+ * 장치 입출력 기록/재생
+ *  --record=PATH : 장치와 주고받은 것을 한 줄씩 남긴다. "<CLOCK_MONOTONIC ns> <종류> <내용>"
+ *      입력  ROT (로터리 한 줄), RTC (RTC_RD_TIME), DHT (DHT11 read), HUB (sensorhub 레코드)
+ *      출력  OLED (write 내용), RTCSET (RTC_SET_TIME)
+ *      INIT  시작할 때 NVRAM 에서 복원한 온습도
+ *      내용의 '\', 줄바꿈, 제어 문자는 "\\", "\n", "\xHH" 로 쓴다
+ *  --replay=PATH : 장치를 열지 않고 기록의 입력을 같은 처리 함수에 넣은 뒤, 만들어진 출력을
+ *      기록의 출력과 순서대로 비교한다 (내용, 시각 차이)
+ */
+#define REPLAY_SHOW_DIFFS   10      // 자세히 출력할 불일치 개수
+
+typedef struct {
+    uint64_t ts;
+    char kind[8];
+    char data[256];         // 이스케이프를 푼 내용 ('\0' 으로 끝남)
+    size_t len;
+} replay_event_t;
+
+typedef struct {
+    replay_event_t* ev;
+    size_t count;
+    size_t next_output;     // 다음에 비교할 기록 출력을 찾기 시작할 인덱스
+    size_t outputs;         // 기록의 출력 개수
+    uint64_t rec_start;     // 기록 첫 줄의 시각
+    uint64_t real_start;    // 재생 시작 시각 (--replay-speed)
+    size_t matched;
+    size_t mismatched;
+    size_t extra;           // 기록에 없는 출력
+    int64_t delta_sum_ns;   // 일치한 출력의 (재생 시각 - 기록 시각) 합
+    int64_t delta_max_ns;   // |재생 시각 - 기록 시각| 최대
+} replay_t;
+
+replay_t replay;
+
+int is_output_kind(const char* kind) {
+    return strcmp(kind, "OLED") == 0 || strcmp(kind, "RTCSET") == 0;
+}
+
+void fput_escaped(FILE* f, const void* data, size_t len) {
+    const unsigned char* p = data;
+    
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '\\') {
+            fputs("\\\\", f);
+        } else if (p[i] == '\n') {
+            fputs("\\n", f);
+        } else if (p[i] < 0x20 || p[i] == 0x7f) {
+            fprintf(f, "\\x%02x", p[i]);
+        } else {
+            fputc(p[i], f);
+        }
+    }
+}
+
+// fput_escaped 의 반대. 길이를 돌려준다
+size_t unescape(const char* s, char* out, size_t size) {
+    size_t n = 0;
+    
+    while (*s && n + 1 < size) {
+        unsigned int c = (unsigned char)*s++;
+        
+        if (c == '\\' && *s) {
+            c = (unsigned char)*s++;
+            if (c == 'n') {
+                c = '\n';
+            } else if (c == 'x' && sscanf(s, "%2x", &c) == 1) {
+                s += 2;
+            }
+        }
+        out[n++] = c;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+int record_open(const char* path) {
+    record_file = fopen(path, "w");
+    return record_file ? 0 : -1;
+}
+
+// 기록 한 줄 (--record 가 없으면 아무것도 하지 않음). 여러 스레드에서 호출된다
+void record_event(const char* kind, const void* data, size_t len) {
+    if (record_file == NULL) {
+        return;
+    }
+    
+    // 시각을 잠금 안에서 읽어 줄 순서와 시각 순서를 맞춘다
+    pthread_mutex_lock(&record_mutex);
+    fprintf(record_file, "%llu %s ", (unsigned long long)now_ns(), kind);
+    fput_escaped(record_file, data, len);
+    fputc('\n', record_file);
+    pthread_mutex_unlock(&record_mutex);
+}
+
+// RTC 시간 <-> 기록 문자열 "YYYY-MM-DD hh:mm:ss"
+int format_rtc_time(char* out, size_t size, const struct rtc_time* tm) {
+    return snprintf(out, size, "%04d-%02d-%02d %02d:%02d:%02d",
+                    tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
+                    tm->tm_hour, tm->tm_min, tm->tm_sec);
+}
+
+int parse_rtc_time(const char* text, struct rtc_time* tm) {
+    memset(tm, 0, sizeof(*tm));
+    if (sscanf(text, "%d-%d-%d %d:%d:%d", &tm->tm_year, &tm->tm_mon, &tm->tm_mday,
+               &tm->tm_hour, &tm->tm_min, &tm->tm_sec) != 6) {
+        return -1;
+    }
+    tm->tm_year -= 1900;
+    tm->tm_mon -= 1;
+    return 0;
+}
+
+int replay_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[1100];
+    size_t cap = 0;
+    
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long ts;
+        replay_event_t* e;
+        int pos = 0;
+        
+        if (replay.count == cap) {
+            cap = cap ? cap * 2 : 1024;
+            e = realloc(replay.ev, cap * sizeof(*e));
+            if (e == NULL) {
+                fclose(f);
+                return -1;
+            }
+            replay.ev = e;
+        }
+        e = &replay.ev[replay.count];
+        
+        line[strcspn(line, "\n")] = '\0';
+        if (sscanf(line, "%llu %7s%n", &ts, e->kind, &pos) != 2) {
+            continue;
+        }
+        if (line[pos] == ' ') {
+            pos++;
+        }
+        e->ts = ts;
+        e->len = unescape(line + pos, e->data, sizeof(e->data));
+        
+        if (is_output_kind(e->kind)) {
+            replay.outputs++;
+        }
+        replay.count++;
+    }
+    
+    fclose(f);
+    return 0;
+}
+
+// 지금을 기록의 시간축으로 (빠른 재생은 가상 시계가 곧 기록 시각)
+uint64_t replay_rec_time(void) {
+    if (replay_speed <= 0) {
+        return replay_clock_ns;
+    }
+    return replay.rec_start + (uint64_t)((now_ns() - replay.real_start) * replay_speed);
+}
+
+void replay_print(const char* label, const char* kind, const void* data, size_t len) {
+    printf("  %s %s ", label, kind);
+    fput_escaped(stdout, data, len);
+    printf("\n");
+}
+
+// 재생 중 만들어진 출력을 기록의 다음 출력과 비교한다
+void replay_output(const char* kind, const void* data, size_t len) {
+    uint64_t now = replay_rec_time();
+    replay_event_t* e = NULL;
+    
+    while (replay.next_output < replay.count) {
+        e = &replay.ev[replay.next_output++];
+        if (is_output_kind(e->kind)) {
+            break;
+        }
+        e = NULL;
+    }
+    
+    if (e == NULL) {
+        if (++replay.extra <= REPLAY_SHOW_DIFFS) {
+            printf("[Replay] 기록에 없는 출력\n");
+            replay_print("재생", kind, data, len);
+        }
+        return;
+    }
+    
+    if (strcmp(e->kind, kind) != 0 || e->len != len || memcmp(e->data, data, len) != 0) {
+        if (++replay.mismatched <= REPLAY_SHOW_DIFFS) {
+            printf("[Replay] 출력 불일치 (기록 %.3f s)\n", (e->ts - replay.rec_start) / 1e9);
+            replay_print("기록", e->kind, e->data, e->len);
+            replay_print("재생", kind, data, len);
+        }
+        return;
+    }
+    
+    int64_t delta = (int64_t)(now - e->ts);
+    
+    replay.matched++;
+    replay.delta_sum_ns += delta;
+    if (llabs(delta) > replay.delta_max_ns) {
+        replay.delta_max_ns = llabs(delta);
+    }
+}
+
+// OLED 쓰기. 기록하거나, 재생 중이면 장치 대신 기록과 비교한다
+void dev_oled_write(const void* buf, size_t len) {
+    if (replay_mode) {
+        replay_output("OLED", buf, len);
+        return;
+    }
+    record_event("OLED", buf, len);
+    write(oled_fd, buf, len);
+}
+
+// RTC_SET_TIME. dev_oled_write 와 같이 기록/재생을 거친다
+int dev_rtc_set(const struct rtc_time* tm) {
+    char text[64];
+    int n = format_rtc_time(text, sizeof(text), tm);
+    
+    if (replay_mode) {
+        replay_output("RTCSET", text, n);
+        return 0;
+    }
+    record_event("RTCSET", text, n);
+    return ioctl(ds1302_fd, RTC_SET_TIME, tm);
+}
+
+// struct rtc_time → time_data_t
+void rtc_to_time_data(const struct rtc_time* tm, time_data_t* time_data) {
+    time_data->year = tm->tm_year - 100;
+    time_data->month = tm->tm_mon + 1;
+    time_data->day = tm->tm_mday;
+    time_data->hour = tm->tm_hour;
+    time_data->minute = tm->tm_min;
+    time_data->second = tm->tm_sec;
+}
+
+// 시간 데이터를 DS1302에 적용 (RTC_SET_TIME, 드라이버에서 유효성 검사)
+int apply_time_to_ds1302(const time_data_t* time_data) {
+    struct rtc_time tm = {0};
+    
+    tm.tm_year = time_data->year + 100;
+    tm.tm_mon = time_data->month - 1;
+    tm.tm_mday = time_data->day;
+    tm.tm_hour = time_data->hour;
+    tm.tm_min = time_data->minute;
+    tm.tm_sec = time_data->second;
+    
+    if (dev_rtc_set(&tm) < 0) {
+        perror("RTC_SET_TIME");
+        return -1;
+    }
     printf("✓ 시간 설정: 20%02d-%02d-%02d %02d:%02d:%02d\n",
            time_data->year, time_data->month, time_data->day,
            time_data->hour, time_data->minute, time_data->second);
+    return 0;
 }
 
-// Thread 1: DS1302
-void* ds1302_thread(void* arg)
+// 편집 중인 필드의 값 포인터
+int* edit_field_ptr(void) {
+    switch(shared.edit_field) {
+        case EDIT_YEAR:   return &shared.edit_time.year;
+        case EDIT_MONTH:  return &shared.edit_time.month;
+        case EDIT_DAY:    return &shared.edit_time.day;
+        case EDIT_HOUR:   return &shared.edit_time.hour;
+        case EDIT_MINUTE: return &shared.edit_time.minute;
+        case EDIT_SECOND: return &shared.edit_time.second;
+        default:          return NULL;
+    }
+}
+
+// 그 달의 날짜 수 (year: 0~99, 2000~2099 는 4 로 나누어지면 윤년)
+int days_in_month(int year, int month) {
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    
+    if (month < 1 || month > 12) {
+        return 31;
+    }
+    return (month == 2 && year % 4 == 0) ? 29 : days[month - 1];
+}
+
+/*
+ * 현재 필드에 delta 만큼 더하고 min~max 범위로 순환 (shared_write_lock 보유 상태).
+ * 일은 그 달의 말일까지만 돌고, 연/월을 바꿔 말일을 넘게 되면 말일로 맞춘다
+ * (드라이버가 2월 31일 같은 날짜를 거부하므로). 로그는 msg 에 만들어 두고 호출한 쪽이
+ * 쓰기 구간을 끝낸 뒤 출력한다.
+ */
+void adjust_edit_field(int delta, const char* tag, char* msg, size_t size) {
+    int* field_ptr = edit_field_ptr();
+    time_data_t* t = &shared.edit_time;
+    
+    if (field_ptr == NULL) {
+        return;
+    }
+    
+    int min = field_limits[shared.edit_field].min;
+    int max = field_limits[shared.edit_field].max;
+    
+    if (shared.edit_field == EDIT_DAY) {
+        max = days_in_month(t->year, t->month);
+    }
+    int range = max - min + 1;
+    
+    *field_ptr = min + ((*field_ptr - min + delta) % range + range) % range;
+    if (t->day > days_in_month(t->year, t->month)) {
+        t->day = days_in_month(t->year, t->month);
+    }
+    request_redraw(1);
+    snprintf(msg, size, "[Rotary] %s → %s: %d\n", tag,
+             field_limits[shared.edit_field].name, *field_ptr);
+}
+
+unsigned char nvram_checksum(const nvram_state_t* st) {
+    const unsigned char* p = (const unsigned char*)st;
+    unsigned char sum = 0;
+    
+    for (size_t i = 0; i < offsetof(nvram_state_t, checksum); i++) {
+        sum += p[i];
+    }
+    return ~sum;
+}
+
+// 마지막으로 저장된 온습도 읽기 (성공 시 0)
+int load_nvram_state(int* temp, int* humi) {
+    nvram_state_t st;
+    int fd = open(NVRAM_PATH, O_RDONLY);
+    
+    if (fd < 0) {
+        return -1;
+    }
+    int ret = pread(fd, &st, sizeof(st), 0);
+    close(fd);
+    
+    if (ret != sizeof(st) || st.magic != NVRAM_MAGIC ||
+        st.version != NVRAM_VERSION || st.checksum != nvram_checksum(&st)) {
+        return -1;
+    }
+    *temp = st.temp;
+    *humi = st.humi;
+    return 0;
+}
+
+// 한 번의 RAM burst 로 기록된다. 값이 바뀔 때만 호출
+void save_nvram_state(int temp, int humi) {
+    nvram_state_t st = {
+        .magic = NVRAM_MAGIC,
+        .version = NVRAM_VERSION,
+        .temp = temp,
+        .humi = humi,
+    };
+    st.checksum = nvram_checksum(&st);
+    
+    int fd = open(NVRAM_PATH, O_WRONLY);
+    if (fd < 0) {
+        return;
+    }
+    if (pwrite(fd, &st, sizeof(st), 0) != sizeof(st)) {
+        perror("NVRAM write");
+    }
+    close(fd);
+}
+
+/*
+ * 온습도 로그 쓰기. 파일은 한 번 미리 할당해 mmap 하고, 레코드는 메모리에만 쓴다.
+ * 디스크 반영(msync + fdatasync)은 log_sync_sec 마다 더러워진 페이지만 모아서 하므로
+ * SD 카드에는 주기마다 데이터 페이지 하나 + 헤더 페이지 정도만 쓰인다.
+ * DHT11 을 읽는 쪽(한 스레드)에서만 호출한다.
+ */
+typedef struct {
+    int fd;
+    sensorlog_header_t* hdr;
+    sensorlog_record_t* rec;
+    size_t map_size;
+    uint32_t dirty_from;        // 마지막 sync 이후 처음 쓴 슬롯
+    int dirty;
+    int64_t last_time;          // 마지막 레코드의 time (레코드는 이 값 이상으로만 쓴다)
+    uint64_t last_record_ns;    // 기록/sync 간격은 CLOCK_MONOTONIC 으로 잰다
+    uint64_t last_sync_ns;
+} sensorlog_t;
+
+sensorlog_t sensorlog = { .fd = -1 };
+
+int sensorlog_open(const char* path, uint32_t capacity) {
+    uint64_t size = sensorlog_file_size(capacity);
+    struct stat st;
+    void* map;
+    int fd;
+    
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    // 기존 파일이면 그 크기(capacity)를 그대로 쓴다. 새로 만든 빈 파일만 포맷하고,
+    // 헤더가 맞지 않는 파일 (경로를 잘못 준 경우) 은 덮어쓰지 않는다
+    if (st.st_size > 0) {
+        sensorlog_header_t h;
+        if (st.st_size >= SENSORLOG_DATA_OFFSET &&
+            pread(fd, &h, sizeof(h), 0) == sizeof(h) &&
+            memcmp(h.magic, SENSORLOG_MAGIC, 4) == 0 && h.version == SENSORLOG_VERSION &&
+            h.record_size == sizeof(sensorlog_record_t) && h.capacity > 0 &&
+            (uint64_t)st.st_size >= sensorlog_file_size(h.capacity)) {
+            capacity = h.capacity;
+            size = sensorlog_file_size(capacity);
+        } else {
+            printf("⚠ Sensor log: 로그 파일이 아닙니다: %s\n", path);
+            close(fd);
+            return -1;
+        }
+    }
+    
+    if (posix_fallocate(fd, 0, size) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    
+    sensorlog.fd = fd;
+    sensorlog.map_size = size;
+    sensorlog.hdr = map;
+    sensorlog.rec = (sensorlog_record_t*)((char*)map + SENSORLOG_DATA_OFFSET);
+    sensorlog.last_sync_ns = now_ns();
+    
+    if (memcmp(sensorlog.hdr->magic, SENSORLOG_MAGIC, 4) != 0) {
+        memset(sensorlog.hdr, 0, sizeof(*sensorlog.hdr));
+        sensorlog.hdr->version = SENSORLOG_VERSION;
+        sensorlog.hdr->record_size = sizeof(sensorlog_record_t);
+        sensorlog.hdr->capacity = capacity;
+        memcpy(sensorlog.hdr->magic, SENSORLOG_MAGIC, 4);
+        msync(sensorlog.hdr, SENSORLOG_DATA_OFFSET, MS_SYNC);
+    } else if (sensorlog.hdr->count > 0) {
+        sensorlog_header_t* h = sensorlog.hdr;
+        sensorlog.last_time = sensorlog.rec[(h->head + h->capacity - 1) % h->capacity].time;
+    }
+    
+    return 0;
+}
+
+// 레코드 슬롯 [from, to) 를 덮는 페이지만 msync
+void sensorlog_msync(uint32_t from, uint32_t to) {
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)&sensorlog.rec[from] & ~(page - 1);
+    uintptr_t end = (uintptr_t)&sensorlog.rec[to];
+    
+    if (to > from) {
+        msync((void*)start, end - start, MS_SYNC);
+    }
+}
+
+// 더러워진 레코드 페이지와 헤더를 디스크에 반영
+void sensorlog_sync(void) {
+    sensorlog_header_t* h = sensorlog.hdr;
+    
+    if (sensorlog.fd < 0 || !sensorlog.dirty) {
+        return;
+    }
+    
+    if (h->head > sensorlog.dirty_from) {
+        sensorlog_msync(sensorlog.dirty_from, h->head);
+    } else {
+        // 링 끝을 넘어갔다
+        sensorlog_msync(sensorlog.dirty_from, h->capacity);
+        sensorlog_msync(0, h->head);
+    }
+    msync(h, SENSORLOG_DATA_OFFSET, MS_SYNC);
+    fdatasync(sensorlog.fd);
+    
+    sensorlog.dirty = 0;
+    sensorlog.last_sync_ns = now_ns();
+}
+
+/*
+ * 레코드 시각은 시스템 시계가 아니라 DS1302 (shared.now, 로컬 시간) 에서 얻는다.
+ * RTC 가 무효이면 직전 레코드 시각을 쓰고 F_TIME_VALID 를 붙이지 않는다.
+ * RTC 가 뒤로 맞춰졌으면 새 구간을 시작한다. logread 의 이진 탐색은 구간 안에서만 시간
+ * 순서를 가정하므로, 잘못 앞으로 맞췄다가 되돌려도 이후 레코드는 바른 시각을 갖는다.
+ */
+int64_t sensorlog_time(uint16_t* flags) {
+    shared_data_t snap;
+    int64_t t = sensorlog.last_time;
+    
+    shared_snapshot(&snap);
+    if (snap.time_valid) {
+        struct tm tm = {
+            .tm_year = snap.now.year + 100,
+            .tm_mon = snap.now.month - 1,
+            .tm_mday = snap.now.day,
+            .tm_hour = snap.now.hour,
+            .tm_min = snap.now.minute,
+            .tm_sec = snap.now.second,
+            .tm_isdst = -1,
+        };
+        int64_t rtc = mktime(&tm);
+        
+        if (rtc != -1) {
+            if (rtc < t) {
+                sensorlog.hdr->segment++;
+                printf("⚠ Sensor log: 시간이 되돌려져 새 구간 %u 시작\n", sensorlog.hdr->segment);
+            }
+            t = rtc;
+            *flags |= SENSORLOG_F_TIME_VALID;
+        }
+    }
+    return t;
+}
+
+// log_period_sec 마다 한 레코드. 주기가 안 됐으면 버린다
+void sensorlog_append(int temp, int humi, uint16_t flags) {
+    sensorlog_header_t* h = sensorlog.hdr;
+    uint64_t now = now_ns();
+    
+    if (sensorlog.fd < 0) {
+        return;
+    }
+    
+    if (sensorlog.last_record_ns == 0 ||
+        now - sensorlog.last_record_ns >= (uint64_t)log_period_sec * 1000000000ULL) {
+        sensorlog_record_t* r = &sensorlog.rec[h->head];
+        
+        r->time = sensorlog_time(&flags);
+        r->temp = temp;
+        r->humi = humi;
+        r->flags = flags;
+        r->segment = (uint16_t)h->segment;
+        
+        if (!sensorlog.dirty) {
+            sensorlog.dirty_from = h->head;
+            sensorlog.dirty = 1;
+        }
+        h->head = (h->head + 1) % h->capacity;
+        h->count++;
+        sensorlog.last_time = r->time;
+        sensorlog.last_record_ns = now;
+    }
+    
+    if (now - sensorlog.last_sync_ns >= (uint64_t)log_sync_sec * 1000000000ULL) {
+        sensorlog_sync();
+    }
+}
+
+// 새 시간 반영
+void update_time(const time_data_t* now)
+{
+    shared_write_lock();
+    shared.now = *now;
+    shared.time_valid = 1;
+    
+    if (shared.screen_mode == SCREEN_NORMAL) {
+        request_redraw(0);
+    }
+    shared_write_unlock();
+}
+
+// RTC_RD_TIME 결과 반영 (ret: ioctl 반환값)
+void apply_rtc_read(int ret, const struct rtc_time* tm)
+{
+    time_data_t now;
+    
+    metric_inc(&metrics.ds1302_reads);
+    if (ret < 0) {
+        metric_inc(&metrics.ds1302_errors);
+        return;
+    }
+    
+    rtc_to_time_data(tm, &now);
+    update_time(&now);
+}
+
+// DS1302 초 틱 처리: poll() 로 깨어난 뒤 호출
+void handle_ds1302_tick(void)
 {
-    char buff[64];
+    struct rtc_time tm;
+    char text[64];
+    uint64_t t0 = now_ns();
     int ret;
     
+    ret = ioctl(ds1302_fd, RTC_RD_TIME, &tm);
+    hist_observe(&metrics.ds1302_read, now_ns() - t0);
+    
+    if (record_file) {
+        if (ret < 0) {
+            record_event("RTC", "ERR", 3);
+        } else {
+            record_event("RTC", text, format_rtc_time(text, sizeof(text), &tm));
+        }
+    }
+    apply_rtc_read(ret, &tm);
+}
+
+// DHT11 샘플 하나 반영 (로그, 화면, NVRAM). ok 가 0 이면 측정 실패
+void update_env(int ok, int temp, int humi)
+{
+    static int saved_temp = -1, saved_humi = -1;
+    
+    if (!ok) {
+        metric_inc(&metrics.dht11_errors);
+        sensorlog_append(0, 0, SENSORLOG_F_READ_ERROR);
+        return;
+    }
+    
+    sensorlog_append(temp, humi, 0);
+    
+    shared_write_lock();
+    shared.temp = temp;
+    shared.humi = humi;
+    
+    if (shared.screen_mode == SCREEN_NORMAL) {
+        request_redraw(0);
+    }
+    shared_write_unlock();
+    
+    printf("[DHT11] 온도: %dC, 습도: %d%%\n", temp, humi);
+    
+    // 재생은 실제 NVRAM 을 건드리지 않는다
+    if (!replay_mode && (temp != saved_temp || humi != saved_humi)) {
+        save_nvram_state(temp, humi);
+        saved_temp = temp;
+        saved_humi = humi;
+    }
+}
+
+// DHT11 read() 결과 반영 (ret: read 반환값, buf: '\0' 으로 끝나는 응답)
+void apply_dht11_read(int ret, char* buf)
+{
+    int temp = 0, humi = 0;
+    int ok = 0;
+    
+    metric_inc(&metrics.dht11_reads);
+    
+    if (ret > 0) {
+        char *newline = strchr(buf, '\n');
+        if (newline) *newline = '\0';
+
+        if (sscanf(buf, "Temp : %d c, Humi : %d", &temp, &humi) == 2 ||
+            sscanf(buf, "temp: %d c humi: %d", &temp, &humi) == 2) {
+            ok = 1;
+        }
+    }
+    
+    update_env(ok, temp, humi);
+}
+
+// DHT11 한 번 측정
+void sample_dht11(void)
+{
+    char buf[64];
+    int ret;
+    uint64_t t0 = now_ns();
+    
+    memset(buf, 0, sizeof(buf));
+    ret = read(dht11_fd, buf, sizeof(buf) - 1);
+    hist_observe(&metrics.dht11_read, now_ns() - t0);
+    
+    if (ret > 0) {
+        buf[ret] = '\0';
+        record_event("DHT", buf, ret);
+    } else {
+        record_event("DHT", "ERR", 3);
+    }
+    apply_dht11_read(ret, buf);
+}
+
+// sensorhub 레코드 하나 반영: 필드별 seq 가 바뀐 것만 처리한다 (문자열 파싱 없음)
+void apply_sensorhub(const struct sensorhub_record* rec)
+{
+    // 시간이 새로 들어온 레코드만 시간 읽기로 센다 (DS1302 ioctl 대신)
+    if (rec->time_seq != hub_seen.time_seq) {
+        metric_inc(&metrics.ds1302_reads);
+    }
+    
+    if (rec->time_seq != hub_seen.time_seq && rec->time_valid) {
+        time_data_t now = {
+            .year = rec->year % 100,
+            .month = rec->month,
+            .day = rec->day,
+            .hour = rec->hour,
+            .minute = rec->minute,
+            .second = rec->second,
+        };
+        update_time(&now);
+    }
+    
+    if (rec->env_seq != hub_seen.env_seq) {
+        metric_inc(&metrics.dht11_reads);
+        if (rec->env_errors != hub_seen.env_errors) {
+            update_env(0, 0, 0);
+        } else if (rec->env_valid) {
+            update_env(1, rec->temp, rec->humi);
+        }
+    }
+    
+    hub_seen = *rec;
+}
+
+// sensorhub 읽기: read() 한 번으로 시간과 온습도를 함께 받는다. 읽을 것이 없으면 -1
+/*
+ * read 는 다음 변경까지 막히므로 (스레드 모드) 걸린 시간을 DS1302 읽기 시간 히스토그램에
+ * 넣지 않는다. 그 히스토그램은 RTC_RD_TIME 경로에서만 잰다.
+ */
+int handle_sensorhub(void)
+{
+    struct sensorhub_record rec;
+    
+    if (read(hub_fd, &rec, sizeof(rec)) != sizeof(rec)) {
+        return -1;
+    }
+    
+    record_event("HUB", &rec, sizeof(rec));
+    apply_sensorhub(&rec);
+    return 0;
+}
+
+// 로터리 이벤트 한 줄 처리. 메모리만 바꾸고 장치 I/O 는 장치 워커에 맡긴다
+void handle_rotary_event(const char* buf)
+{
+    char msg[96] = "";      // 로그. 쓰기 구간 안에서 printf 하면 stdout 이 막힐 때 읽는 쪽이 돈다
+    char event[16];
+    int delta = 0;
+    unsigned long long ts = 0;
+    
+    record_event("ROT", buf, strlen(buf));
+    
+    if (sscanf(buf, "%15s", event) < 1) {
+        return;
+    }
+    
+    // 이벤트 시각 (커널 ktime_get, CLOCK_MONOTONIC ns). DELTA 는 스텝 뒤 네 번째 값
+    if (strstr(event, "DELTA") != NULL) {
+        sscanf(buf, "%*s %d %*u %llu", &delta, &ts);
+    } else {
+        sscanf(buf, "%*s %llu", &ts);
+    }
+    if (ts == 0) {
+        ts = now_ns();
+    }
+    metric_inc(&metrics.rotary_events);
+    
+    shared_write_lock();
+    
+    if (strcmp(event, "CLICK") == 0) {
+        if (shared.screen_mode == SCREEN_NORMAL) {
+            // 편집 모드 진입
+            snprintf(msg, sizeof(msg), "[Rotary] CLICK → 시간 편집 모드 진입\n");
+            
+            // 현재 시간을 편집 버퍼로 복사
+            shared.edit_time = shared.now;
+            
+            shared.screen_mode = SCREEN_TIME_EDIT;
+            shared.edit_field = EDIT_YEAR;
+            request_redraw(1);
+        }
+        else if (shared.screen_mode == SCREEN_TIME_EDIT) {
+            // 다음 필드로 이동
+            shared.edit_field++;
+            
+            if (shared.edit_field >= EDIT_DONE) {
+                // 편집 완료 → 장치 워커가 DS1302에 적용
+                snprintf(msg, sizeof(msg), "[Rotary] CLICK → 시간 보정 완료\n");
+                
+                shared.rtc_commit = shared.edit_time;
+                shared.rtc_pending = 1;
+                
+                shared.screen_mode = SCREEN_NORMAL;
+                shared.edit_field = EDIT_YEAR;
+                
+                // 화면은 워커가 커밋한 뒤 결과 메시지로 바꾼다 (run_next_command)
+                request_redraw(0);
+            }
+            else {
+                snprintf(msg, sizeof(msg), "[Rotary] CLICK → %s 편집\n",
+                         field_limits[shared.edit_field].name);
+                request_redraw(1);
+            }
+        }
+    }
+    else if (strcmp(event, "CW") == 0) {
+        if (shared.screen_mode == SCREEN_TIME_EDIT) {
+            adjust_edit_field(1, "CW", msg, sizeof(msg));
+        }
+    }
+    else if (strcmp(event, "CCW") == 0) {
+        if (shared.screen_mode == SCREEN_TIME_EDIT) {
+            adjust_edit_field(-1, "CCW", msg, sizeof(msg));
+        }
+    }
+    else if (strcmp(event, "DELTA") == 0) {
+        // 누적 모드: "DELTA +12 40 <ts>" (스텝, detents/s, 타임스탬프 ns)
+        if (shared.screen_mode == SCREEN_TIME_EDIT && delta != 0) {
+            adjust_edit_field(delta, "DELTA", msg, sizeof(msg));
+        }
+    }
+    else if (strcmp(event, "HOLD_CW") == 0 || strcmp(event, "HOLD_CCW") == 0 ||
+             strcmp(event, "HOLD_DELTA") == 0) {
+        // 누른 채 회전: 10 단위로 크게 이동
+        if (shared.screen_mode == SCREEN_TIME_EDIT) {
+            int steps = strcmp(event, "HOLD_CW") == 0 ? 1 :
+                        strcmp(event, "HOLD_CCW") == 0 ? -1 : delta;
+            adjust_edit_field(steps * COARSE_STEP, event, msg, sizeof(msg));
+        }
+    }
+    else if (strcmp(event, "DOUBLE") == 0) {
+        // 더블 클릭: 이전 필드로 돌아가기
+        if (shared.screen_mode == SCREEN_TIME_EDIT && shared.edit_field > EDIT_YEAR) {
+            shared.edit_field--;
+            request_redraw(1);
+            snprintf(msg, sizeof(msg), "[Rotary] DOUBLE → %s 편집\n",
+                     field_limits[shared.edit_field].name);
+        }
+    }
+    else if (strcmp(event, "LONG") == 0) {
+        // 길게 누르기: 저장하지 않고 편집 취소
+        if (shared.screen_mode == SCREEN_TIME_EDIT) {
+            snprintf(msg, sizeof(msg), "[Rotary] LONG → 시간 편집 취소\n");
+            shared.screen_mode = SCREEN_NORMAL;
+            shared.edit_field = EDIT_YEAR;
+            request_redraw(1);
+        }
+    }
+    
+    // 화면이 바뀌는 입력이면 지연 측정 시작점으로 남긴다
+    if (shared.redraw_input && shared.input_ts_ns == 0) {
+        shared.input_ts_ns = ts;
+    }
+    
+    shared_write_unlock();
+    
+    if (msg[0] != '\0') {
+        printf("%s", msg);
+    }
+}
+
+/*
+ * 화면 위젯 (retained). 각 위젯은 영역(page, col, width 픽셀)과 마지막으로 그린 문자열을
+ * 기억한다. 값이 바뀐 위젯의 영역만 "AT:" 명령으로 보내고, 화면이 바뀌면 이전 화면의
+ * 위젯 중 새 위젯이 덮지 않는 영역만 지운다 (전체 CLEAR 없음).
+ */
+typedef enum {
+    W_TEMP,
+    W_HUMI,
+    W_DATE,
+    W_TIME,
+    W_EDIT_NAME,
+    W_EDIT_VALUE,
+    W_MESSAGE,
+    W_COUNT
+} widget_id_t;
+
+typedef struct {
+    screen_mode_t screen;       // 이 위젯이 보이는 화면
+    unsigned char page;
+    unsigned char col;
+    unsigned char width;
+    char text[24];              // 마지막으로 그린 값
+} widget_t;
+
+// 기존 DATE: 포맷과 같은 배치
+widget_t widgets[W_COUNT] = {
+    [W_TEMP]       = { SCREEN_NORMAL,    0, 70, 58 },
+    [W_HUMI]       = { SCREEN_NORMAL,    1, 70, 58 },
+    [W_DATE]       = { SCREEN_NORMAL,    3,  0, 70 },
+    [W_TIME]       = { SCREEN_NORMAL,    4,  0, 70 },
+    [W_EDIT_NAME]  = { SCREEN_TIME_EDIT, 0,  0, 128 },
+    [W_EDIT_VALUE] = { SCREEN_TIME_EDIT, 1,  0, 128 },
+    [W_MESSAGE]    = { SCREEN_MESSAGE,   0,  0, 128 },
+};
+
+// 한 프레임의 "AT:" 명령을 모아 write 한 번으로 보낸다 (드라이버 버퍼 256 바이트)
+typedef struct {
+    char buf[240];
+    size_t len;
+} oled_batch_t;
+
+void oled_batch_flush(oled_batch_t* b) {
+    if (b->len > 0) {
+        dev_oled_write(b->buf, b->len);
+        b->len = 0;
+    }
+}
+
+void oled_batch_add(oled_batch_t* b, const widget_t* w, const char* text) {
+    char line[64];
+    int n = snprintf(line, sizeof(line), "AT:%d,%d,%d:%s\n", w->page, w->col, w->width, text);
+    
+    if (b->len + n > sizeof(b->buf)) {
+        oled_batch_flush(b);
+    }
+    memcpy(b->buf + b->len, line, n);
+    b->len += n;
+}
+
+// 스냅샷에서 위젯에 보일 문자열
+void widget_value(widget_id_t id, const shared_data_t* snap, char* out, size_t size) {
+    const time_data_t* t = &snap->now;
+    const int* field;
+    
+    switch (id) {
+        case W_TEMP:
+            if (snap->temp >= 0) snprintf(out, size, "T:%dC", snap->temp);
+            else                 snprintf(out, size, "T:--C");
+            break;
+        case W_HUMI:
+            if (snap->humi >= 0) snprintf(out, size, "H:%d%%", snap->humi);
+            else                 snprintf(out, size, "H:--%%");
+            break;
+        case W_DATE:
+            if (snap->time_valid) snprintf(out, size, "%04d-%02d-%02d", t->year + 2000, t->month, t->day);
+            else                  snprintf(out, size, "----");
+            break;
+        case W_TIME:
+            if (snap->time_valid) snprintf(out, size, "%02d:%02d:%02d", t->hour, t->minute, t->second);
+            else                  snprintf(out, size, "--:--:--");
+            break;
+        case W_EDIT_NAME:
+            snprintf(out, size, "Edit: %s", field_limits[snap->edit_field].name);
+            break;
+        case W_EDIT_VALUE:
+            field = snap->edit_field == EDIT_YEAR   ? &snap->edit_time.year :
+                    snap->edit_field == EDIT_MONTH  ? &snap->edit_time.month :
+                    snap->edit_field == EDIT_DAY    ? &snap->edit_time.day :
+                    snap->edit_field == EDIT_HOUR   ? &snap->edit_time.hour :
+                    snap->edit_field == EDIT_MINUTE ? &snap->edit_time.minute :
+                                                      &snap->edit_time.second;
+            snprintf(out, size, ">> %02d <<", *field);
+            break;
+        case W_MESSAGE:
+            snprintf(out, size, snap->message_error ? "Save Failed!" : "Time Saved!");
+            break;
+        default:
+            out[0] = '\0';
+    }
+}
+
+// 같은 page 에서 새 화면의 위젯이 old 영역을 완전히 덮으면 지울 필요가 없다
+int widget_covered(const widget_t* old, screen_mode_t screen) {
+    for (int i = 0; i < W_COUNT; i++) {
+        const widget_t* w = &widgets[i];
+        if (w->screen == screen && w->page == old->page &&
+            w->col <= old->col && w->col + w->width >= old->col + old->width) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 화면 그리기. 스냅샷만 보므로 잠금 없이 OLED I/O 를 한다.
+ * last_mode 는 호출한 쪽이 유지 (마지막으로 그린 화면)
+ */
+void render_display(const shared_data_t* snap, screen_mode_t* last_mode)
+{
+    screen_mode_t screen = snap->message_hold ? SCREEN_MESSAGE : snap->screen_mode;
+    oled_batch_t batch = { .len = 0 };
+    char text[24];
+    int changed = 0;
+    
+    // 첫 프레임: 패널에 남아 있던 내용을 한 번 지운다
+    if (*last_mode == (screen_mode_t)-1) {
+        dev_oled_write("CLEAR", 5);
+    }
+    
+    if (screen != *last_mode) {
+        for (int i = 0; i < W_COUNT; i++) {
+            widget_t* w = &widgets[i];
+            
+            // 이전 화면에서 남는 영역만 지운다
+            if (w->screen == *last_mode && !widget_covered(w, screen)) {
+                oled_batch_add(&batch, w, "");
+            }
+            // 새 화면의 위젯은 모두 다시 그리도록
+            w->text[0] = '\0';
+        }
+        *last_mode = screen;
+    }
+    
+    for (int i = 0; i < W_COUNT; i++) {
+        widget_t* w = &widgets[i];
+        
+        if (w->screen != screen) {
+            continue;
+        }
+        widget_value(i, snap, text, sizeof(text));
+        if (w->text[0] != '\0' && strcmp(text, w->text) == 0) {
+            continue;
+        }
+        
+        snprintf(w->text, sizeof(w->text), "%s", text);
+        oled_batch_add(&batch, w, text);
+        changed++;
+    }
+    
+    oled_batch_flush(&batch);
+    
+    if (changed > 0) {
+        printf("[OLED] Updated %d widget(s)\n", changed);
+    }
+}
+
+// 스냅샷을 떠서 한 프레임 그리고, 프레임/입력 지연 메트릭을 기록한다
+void draw_frame(screen_mode_t* last_mode)
+{
+    shared_data_t snap;
+    uint64_t t0;
+    
+    shared_snapshot(&snap);
+    
+    t0 = now_ns();
+    render_display(&snap, last_mode);
+    metrics_frame_done(t0);
+    
+    if (snap.input_ts_ns != 0) {
+        hist_observe(&metrics.input_latency, now_ns() - snap.input_ts_ns);
+        
+        shared_write_lock();
+        if (shared.input_ts_ns == snap.input_ts_ns) {
+            shared.input_ts_ns = 0;
+        }
+        shared_write_unlock();
+    }
+}
+
+// Thread 1: DS1302
+void* ds1302_thread(void* arg)
+{
     printf("[DS1302] Thread started\n");
+    rt_apply_io_self();
     
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    
+    // sensorhub 가 있으면 시간과 온습도를 함께 받는다 (변경이 있을 때까지 블록)
+    while (shared.running && hub_fd >= 0) {
+        if (handle_sensorhub() < 0) {
+            sleep(1);
+        }
+    }
     
     while (shared.running) {
-        memset(buff, 0, sizeof(buff));
-        ret = read(ds1302_fd, buff, sizeof(buff) - 1);
-        
-        if (ret > 0) {
-            buff[ret] = '\0';
-            char *newline = strchr(buff, '\n');
-            if (newline) *newline = '\0';
-            
-            pthread_mutex_lock(&data_mutex);
-            strncpy(shared.ds1302_data, buff, sizeof(shared.ds1302_data) - 1);
-            
-            if (shared.screen_mode == SCREEN_NORMAL) {
-                shared.update_display = 1;
-            }
-            pthread_mutex_unlock(&data_mutex);
+        // 드라이버가 초 경계에서 깨워 준다 (sleep(1) 로 인한 드리프트 없음)
+        struct pollfd pfd = { .fd = ds1302_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 2000) <= 0) {
+            continue;
         }
         
-        sleep(1);
+        handle_ds1302_tick();
     }
     
     return NULL;
@@ -162,20 +1737,21 @@ void* ds1302_thread(void* arg)
 // Thread 2: DHT11
 void* dht11_thread(void* arg)
 {
-    char buf[64];
-    int temp, humi;
-    int ret;
-
     printf("[DHT11] Thread started\n");
+    rt_apply_io_self();
 
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
     if (dht11_fd < 0) {
-        pthread_mutex_lock(&data_mutex);
+        shared_write_lock();
         shared.temp = -1;
         shared.humi = -1;
-        pthread_mutex_unlock(&data_mutex);
+        shared_write_unlock();
+    }
+
+    // sensorhub 모드에서는 ds1302_thread 가 온습도도 받는다
+    if (hub_fd >= 0) {
+        return NULL;
     }
 
     while (shared.running) {
@@ -184,31 +1760,8 @@ void* dht11_thread(void* arg)
             continue;
         }
 
-        memset(buf, 0, sizeof(buf));
-        ret = read(dht11_fd, buf, sizeof(buf) - 1);
-        
-        if (ret > 0) {
-            buf[ret] = '\0';
-            char *newline = strchr(buf, '\n');
-            if (newline) *newline = '\0';
-
-            if (sscanf(buf, "Temp : %d c, Humi : %d", &temp, &humi) == 2 ||
-                sscanf(buf, "temp: %d c humi: %d", &temp, &humi) == 2) {
-                
-                pthread_mutex_lock(&data_mutex);
-                shared.temp = temp;
-                shared.humi = humi;
-                
-                if (shared.screen_mode == SCREEN_NORMAL) {
-                    shared.update_display = 1;
-                }
-                pthread_mutex_unlock(&data_mutex);
-                
-                printf("[DHT11] 온도: %dC, 습도: %d%%\n", temp, humi);
-            }
-        }
-
-        sleep(3);
+        sample_dht11();
+        sleep(DHT11_PERIOD_SEC);
     }
 
     return NULL;
@@ -217,213 +1770,538 @@ void* dht11_thread(void* arg)
 // Thread 3: 로터리
 void* rotary_thread(void* arg)
 {
-    char event[16];
+    char buf[64];
     int ret;
     
     printf("[Rotary] Thread started\n");
+    rt_apply_self("rotary", rt_prio);
     
     pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
     
     while (shared.running) {
-        ret = read(rotary_fd, event, sizeof(event) - 1);
+        ret = read(rotary_fd, buf, sizeof(buf) - 1);
         
         if (ret > 0) {
-            event[ret] = '\0';
-            char *newline = strchr(event, '\n');
-            if (newline) *newline = '\0';
+            buf[ret] = '\0';
+            handle_rotary_event(buf);
+        }
+    }
+    
+    return NULL;
+}
+
+struct timespec ns_to_timespec(uint64_t ns) {
+    struct timespec ts = { ns / 1000000000ULL, ns % 1000000000ULL };
+    return ts;
+}
+
+// 장치 명령 (우선순위 순)
+typedef enum {
+    CMD_NONE,
+    CMD_DRAW_INPUT,         // 입력으로 인한 화면 갱신
+    CMD_RTC_COMMIT,         // 편집한 시간을 DS1302 에 쓰기
+    CMD_DRAW_PERIODIC       // 센서/초 틱 화면 갱신 (MIN_FRAME_MS 간격)
+} device_cmd_t;
+
+/*
+ * 장치 명령 큐. 명령은 shared 의 플래그로 표현되므로 같은 종류는 저절로 하나로 합쳐진다
+ * (화면은 최신 상태 한 프레임, RTC 는 마지막 커밋 값). 가장 우선순위가 높은 명령 하나를
+ * 실행하고 그 종류를 돌려준다. data_mutex 보유 상태로 호출하며 장치 I/O 동안에는 푼다.
+ */
+device_cmd_t run_next_command(screen_mode_t* last_mode, uint64_t* next_frame_ns)
+{
+    uint64_t now = now_ns();
+    device_cmd_t cmd = CMD_NONE;
+    time_data_t commit;
+    int ret;
+    
+    // 저장 결과 표시가 끝나면 원래 화면을 입력 우선순위로 다시 그린다
+    if (shared.message_hold && now >= shared.hold_until_ns) {
+        shared_write_begin();
+        shared.message_hold = 0;
+        request_redraw(1);
+        shared_write_end();
+    }
+    
+    if (shared.update_display && shared.redraw_input) {
+        cmd = CMD_DRAW_INPUT;
+    } else if (shared.rtc_pending) {
+        cmd = CMD_RTC_COMMIT;
+    } else if (shared.update_display && now >= *next_frame_ns) {
+        cmd = CMD_DRAW_PERIODIC;
+    }
+    
+    switch (cmd) {
+        case CMD_DRAW_INPUT:
+        case CMD_DRAW_PERIODIC:
+            shared.update_display = 0;
+            shared.redraw_input = 0;
+            pthread_mutex_unlock(&data_mutex);
             
-            pthread_mutex_lock(&data_mutex);
+            draw_frame(last_mode);
             
-            if (strcmp(event, "CLICK") == 0) {
-                if (shared.screen_mode == SCREEN_NORMAL) {
-                    // 편집 모드 진입
-                    printf("[Rotary] CLICK → 시간 편집 모드 진입\n");
-                    
-                    // 현재 시간을 편집 버퍼로 복사
-                    parse_ds1302_time(shared.ds1302_data, &shared.edit_time);
-                    
-                    shared.screen_mode = SCREEN_TIME_EDIT;
-                    shared.edit_field = EDIT_YEAR;
-                    shared.update_display = 1;
-                }
-                else if (shared.screen_mode == SCREEN_TIME_EDIT) {
-                    // 다음 필드로 이동
-                    shared.edit_field++;
-                    
-                    if (shared.edit_field >= EDIT_DONE) {
-                        // 편집 완료 → DS1302에 적용
-                        printf("[Rotary] CLICK → 시간 보정 완료\n");
-                        
-                        apply_time_to_ds1302(&shared.edit_time);
-                        
-                        shared.screen_mode = SCREEN_NORMAL;
-                        shared.edit_field = EDIT_YEAR;
-                        
-                        // 완료 메시지
-                        write(oled_fd, "Time Saved!", 11);
-                        pthread_mutex_unlock(&data_mutex);
-                        sleep(1);
-                        pthread_mutex_lock(&data_mutex);
-                    }
-                    else {
-                        printf("[Rotary] CLICK → %s 편집\n", 
-                               field_limits[shared.edit_field].name);
-                    }
-                    
-                    shared.update_display = 1;
-                }
-            }
-            else if (strcmp(event, "CW") == 0) {
-                if (shared.screen_mode == SCREEN_TIME_EDIT) {
-                    // 현재 필드 값 증가
-                    int* field_ptr;
-                    
-                    switch(shared.edit_field) {
-                        case EDIT_YEAR:   field_ptr = &shared.edit_time.year;   break;
-                        case EDIT_MONTH:  field_ptr = &shared.edit_time.month;  break;
-                        case EDIT_DAY:    field_ptr = &shared.edit_time.day;    break;
-                        case EDIT_HOUR:   field_ptr = &shared.edit_time.hour;   break;
-                        case EDIT_MINUTE: field_ptr = &shared.edit_time.minute; break;
-                        case EDIT_SECOND: field_ptr = &shared.edit_time.second; break;
-                        default: field_ptr = NULL;
-                    }
-                    
-                    if (field_ptr) {
-                        (*field_ptr)++;
-                        if (*field_ptr > field_limits[shared.edit_field].max) {
-                            *field_ptr = field_limits[shared.edit_field].min;
-                        }
-                        shared.update_display = 1;
-                        printf("[Rotary] CW → %s: %d\n", 
-                               field_limits[shared.edit_field].name, *field_ptr);
-                    }
-                }
-            }
-            else if (strcmp(event, "CCW") == 0) {
-                if (shared.screen_mode == SCREEN_TIME_EDIT) {
-                    // 현재 필드 값 감소
-                    int* field_ptr;
-                    
-                    switch(shared.edit_field) {
-                        case EDIT_YEAR:   field_ptr = &shared.edit_time.year;   break;
-                        case EDIT_MONTH:  field_ptr = &shared.edit_time.month;  break;
-                        case EDIT_DAY:    field_ptr = &shared.edit_time.day;    break;
-                        case EDIT_HOUR:   field_ptr = &shared.edit_time.hour;   break;
-                        case EDIT_MINUTE: field_ptr = &shared.edit_time.minute; break;
-                        case EDIT_SECOND: field_ptr = &shared.edit_time.second; break;
-                        default: field_ptr = NULL;
-                    }
-                    
-                    if (field_ptr) {
-                        (*field_ptr)--;
-                        if (*field_ptr < field_limits[shared.edit_field].min) {
-                            *field_ptr = field_limits[shared.edit_field].max;
-                        }
-                        shared.update_display = 1;
-                        printf("[Rotary] CCW → %s: %d\n", 
-                               field_limits[shared.edit_field].name, *field_ptr);
-                    }
-                }
-            }
+            data_mutex_lock();
+            *next_frame_ns = now_ns() + MIN_FRAME_MS * 1000000ULL;
+            break;
             
+        case CMD_RTC_COMMIT:
+            commit = shared.rtc_commit;
+            shared.rtc_pending = 0;
             pthread_mutex_unlock(&data_mutex);
+            
+            ret = apply_time_to_ds1302(&commit);
+            
+            data_mutex_lock();
+            
+            // 결과 메시지는 렌더러가 그리고 SAVED_MSG_MS 뒤 해제한다
+            shared_write_begin();
+            shared.message_error = (ret < 0);
+            shared.message_hold = 1;
+            shared.hold_until_ns = now_ns() + SAVED_MSG_MS * 1000000ULL;
+            request_redraw(1);
+            shared_write_end();
+            break;
+            
+        default:
+            break;
+    }
+    
+    return cmd;
+}
+
+// 다음에 할 일이 생기는 시각 (data_mutex 보유 상태). 없으면 UINT64_MAX
+uint64_t next_command_deadline(uint64_t next_frame_ns) {
+    uint64_t deadline = UINT64_MAX;
+    
+    if (shared.update_display) {
+        deadline = next_frame_ns;
+    }
+    if (shared.message_hold && shared.hold_until_ns < deadline) {
+        deadline = shared.hold_until_ns;
+    }
+    return deadline;
+}
+
+// Thread 4: 장치 워커 (OLED / DS1302 쓰기)
+void* device_thread(void* arg)
+{
+    screen_mode_t last_mode = -1;
+    uint64_t next_frame_ns = 0;
+    
+    printf("[Device] Thread started\n");
+    rt_apply_self("device", rt_prio - 1);
+    
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    
+    data_mutex_lock();
+    
+    while (shared.running) {
+        if (run_next_command(&last_mode, &next_frame_ns) != CMD_NONE) {
+            continue;
+        }
+        
+        // 할 일이 없으면 요청(입력은 바로) 또는 다음 프레임/메시지 해제 시각까지 잔다
+        uint64_t deadline = next_command_deadline(next_frame_ns);
+        if (deadline == UINT64_MAX) {
+            pthread_cond_wait(&redraw_cond, &data_mutex);
+        } else {
+            struct timespec ts = ns_to_timespec(deadline);
+            pthread_cond_timedwait(&redraw_cond, &data_mutex, &ts);
         }
     }
     
+    pthread_mutex_unlock(&data_mutex);
+    
     return NULL;
 }
 
-// Thread 4: OLED
-void* oled_thread(void* arg)
+// 이벤트 루프의 fd 종류 (epoll_event.data.u32)
+enum {
+    SRC_DS1302,
+    SRC_ROTARY,
+    SRC_DHT11,
+    SRC_REDRAW,
+    SRC_WORKER_TIMER,
+    SRC_HUB,
+    SRC_SIGNAL
+};
+
+int epoll_add(int epfd, int fd, unsigned int src)
+{
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = src };
+    
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+    return 0;
+}
+
+// 주기(또는 1회) 타이머. first_ms 후 처음 만료, period_ms 가 0 이면 1회
+void arm_timerfd(int tfd, long first_ms, long period_ms)
+{
+    struct itimerspec its = {
+        .it_value = { first_ms / 1000, (first_ms % 1000) * 1000000L },
+        .it_interval = { period_ms / 1000, (period_ms % 1000) * 1000000L },
+    };
+    
+    // it_value 가 0 이면 해제되므로 "즉시" 는 1ns 로
+    if (first_ms == 0) {
+        its.it_value.tv_nsec = 1;
+    }
+    timerfd_settime(tfd, 0, &its, NULL);
+}
+
+/*
+ * 단일 스레드 이벤트 루프. 고정 주기로 깨어나는 곳이 없다.
+ *  - DS1302: 드라이버가 초 경계에서 fd 를 readable 로 만든다 (자체 틱)
+ *  - DHT11 : timerfd 주기 타이머
+ *  - sensorhub 가 있으면 위 둘 대신 /dev/sensorhub 하나 (드라이버가 백그라운드 측정)
+ *  - 로터리: fd (O_NONBLOCK, EAGAIN 까지 모두 읽음)
+ *  - 화면/RTC 쓰기: 묶음을 처리한 뒤 run_next_command() 로 우선순위대로 실행한다.
+ *            request_redraw() 의 eventfd 는 깨우기만 하고, 같은 epoll_wait 묶음 안의
+ *            요청은 한 프레임으로 합쳐진다. 다음 프레임/메시지 해제는 timerfd
+ *  - 메트릭: 여기서 받지 않고 metrics_thread 가 처리한다 (요청을 기다리는 동안 루프가 멈춤)
+ *  - 종료 시그널: signalfd. 루프만 빠져나오고 정리는 main 이 한다
+ */
+int run_event_loop(void)
 {
+    struct epoll_event events[8];
     screen_mode_t last_mode = -1;
-    char display_buf[256];
+    uint64_t next_frame_ns = 0;
+    int dht11_tfd = -1;
+    int worker_tfd;
+    int sig_fd;
+    int epfd;
     
-    printf("[OLED] Thread started\n");
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    worker_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    sig_fd = signalfd(-1, &shutdown_sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (epfd < 0 || worker_tfd < 0 || sig_fd < 0 || redraw_efd < 0) {
+        perror("event loop");
+        return -1;
+    }
     
-    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
-    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    fcntl(rotary_fd, F_SETFL, fcntl(rotary_fd, F_GETFL) | O_NONBLOCK);
+    
+    if (hub_fd >= 0) {
+        fcntl(hub_fd, F_SETFL, fcntl(hub_fd, F_GETFL) | O_NONBLOCK);
+        if (epoll_add(epfd, hub_fd, SRC_HUB) < 0) {
+            return -1;
+        }
+    } else if (epoll_add(epfd, ds1302_fd, SRC_DS1302) < 0) {
+        return -1;
+    }
+    
+    if (epoll_add(epfd, rotary_fd, SRC_ROTARY) < 0 ||
+        epoll_add(epfd, redraw_efd, SRC_REDRAW) < 0 ||
+        epoll_add(epfd, worker_tfd, SRC_WORKER_TIMER) < 0 ||
+        epoll_add(epfd, sig_fd, SRC_SIGNAL) < 0) {
+        return -1;
+    }
+    
+    if (dht11_fd >= 0 && hub_fd < 0) {
+        dht11_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (dht11_tfd < 0 || epoll_add(epfd, dht11_tfd, SRC_DHT11) < 0) {
+            return -1;
+        }
+        arm_timerfd(dht11_tfd, 0, DHT11_PERIOD_SEC * 1000L);
+    }
+    
+    // 한 스레드가 입력과 렌더를 모두 하므로 입력 우선순위로
+    rt_apply_self("loop", rt_prio);
+    
+    printf("[Loop] Event loop started\n");
     
     while (shared.running) {
-        pthread_mutex_lock(&data_mutex);
+        int n = epoll_wait(epfd, events, 8, -1);
         
-        if (shared.update_display) {
-            
-            if (last_mode != shared.screen_mode) {
-                write(oled_fd, "CLEAR", 5);
-                usleep(50000);
-                last_mode = shared.screen_mode;
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
             }
+            perror("epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < n; i++) {
+            uint64_t count;
+            char buf[64];
+            int ret;
             
-            if (shared.screen_mode == SCREEN_NORMAL) {
-                int year, month, day, hour, minute, second;
-                
-                if (sscanf(shared.ds1302_data, "%d-%d-%d %d:%d:%d",
-                          &year, &month, &day, &hour, &minute, &second) == 6) {
+            switch (events[i].data.u32) {
+                case SRC_DS1302:
+                    handle_ds1302_tick();
+                    break;
+                    
+                case SRC_HUB:
+                    handle_sensorhub();
+                    break;
                     
-                    // 특수 포맷으로 전송
-                    // "DATE:2025-12-28\nTIME:14:30:25\nTEMP:25\nHUMI:60"
-                    if (shared.temp >= 0 && shared.humi >= 0) {
-                        snprintf(display_buf, sizeof(display_buf),
-                                "DATE:%04d-%02d-%02d\nTIME:%02d:%02d:%02d\nTEMP:%d\nHUMI:%d",
-                                year, month, day,
-                                hour, minute, second,
-                                shared.temp, shared.humi);
-                    } else {
-                        snprintf(display_buf, sizeof(display_buf),
-                                "DATE:%04d-%02d-%02d\nTIME:%02d:%02d:%02d\nTEMP:--\nHUMI:--",
-                                year, month, day,
-                                hour, minute, second);
+                case SRC_ROTARY:
+                    while ((ret = read(rotary_fd, buf, sizeof(buf) - 1)) > 0) {
+                        buf[ret] = '\0';
+                        handle_rotary_event(buf);
                     }
-                } else {
-                    snprintf(display_buf, sizeof(display_buf),
-                            "DATE:----\nTIME:--:--:--\nTEMP:--\nHUMI:--");
-                }
-                
-                write(oled_fd, display_buf, strlen(display_buf));
-                printf("[OLED] Updated\n");
-            }
-            else if (shared.screen_mode == SCREEN_TIME_EDIT) {
-                const char* field_name = field_limits[shared.edit_field].name;
-                int field_value;
-                
-                switch(shared.edit_field) {
-                    case EDIT_YEAR:   field_value = shared.edit_time.year;   break;
-                    case EDIT_MONTH:  field_value = shared.edit_time.month;  break;
-                    case EDIT_DAY:    field_value = shared.edit_time.day;    break;
-                    case EDIT_HOUR:   field_value = shared.edit_time.hour;   break;
-                    case EDIT_MINUTE: field_value = shared.edit_time.minute; break;
-                    case EDIT_SECOND: field_value = shared.edit_time.second; break;
-                    default: field_value = 0;
+                    break;
+                    
+                case SRC_DHT11:
+                    read(dht11_tfd, &count, sizeof(count));
+                    sample_dht11();
+                    break;
+                    
+                case SRC_WORKER_TIMER:
+                    read(worker_tfd, &count, sizeof(count));
+                    break;
+                    
+                case SRC_REDRAW:
+                    read(redraw_efd, &count, sizeof(count));
+                    break;
+                    
+                case SRC_SIGNAL: {
+                    struct signalfd_siginfo si;
+                    read(sig_fd, &si, sizeof(si));
+                    printf("\n종료 중...\n");
+                    shared.running = 0;
+                    break;
                 }
-                
-                // 편집 화면
-                snprintf(display_buf, sizeof(display_buf),
-                        "Edit: %s\n>> %02d <<",
-                        field_name,
-                        field_value);
-                
-                write(oled_fd, display_buf, strlen(display_buf));
-                printf("[OLED] Edit: %s = %d\n", field_name, field_value);
             }
-            
-            shared.update_display = 0;
         }
         
+        // 입력 처리 뒤 장치 명령을 우선순위대로 실행하고, 남은 일의 시각에 타이머를 건다
+        data_mutex_lock();
+        while (run_next_command(&last_mode, &next_frame_ns) != CMD_NONE) {
+        }
+        uint64_t deadline = next_command_deadline(next_frame_ns);
         pthread_mutex_unlock(&data_mutex);
         
-        usleep(100000);
+        struct itimerspec its = {0};
+        if (deadline != UINT64_MAX) {
+            its.it_value = ns_to_timespec(deadline > 0 ? deadline : 1);
+        }
+        timerfd_settime(worker_tfd, TFD_TIMER_ABSTIME, &its, NULL);
     }
     
-    return NULL;
+    close(epfd);
+    close(worker_tfd);
+    close(sig_fd);
+    if (dht11_tfd >= 0) close(dht11_tfd);
+    
+    return 0;
+}
+
+// 재생 시각 → now_ns() 의 시간축
+uint64_t replay_due(uint64_t rec_ts) {
+    if (replay_speed <= 0) {
+        return rec_ts;
+    }
+    return replay.real_start + (uint64_t)((rec_ts - replay.rec_start) / replay_speed);
+}
+
+void replay_sleep_until(uint64_t t) {
+    if (replay_speed > 0) {
+        struct timespec ts = ns_to_timespec(t);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    } else if (t > replay_clock_ns) {
+        replay_clock_ns = t;
+    }
+}
+
+// t 이전에 할 일이 생기는 장치 명령을 그 시각에 실행하고 t 까지 기다린다 (UINT64_MAX: 모두)
+void replay_run_until(uint64_t t, screen_mode_t* last_mode, uint64_t* next_frame_ns)
+{
+    data_mutex_lock();
+    for (;;) {
+        while (run_next_command(last_mode, next_frame_ns) != CMD_NONE) {
+        }
+        uint64_t deadline = next_command_deadline(*next_frame_ns);
+        if (deadline == UINT64_MAX || deadline > t) {
+            break;
+        }
+        pthread_mutex_unlock(&data_mutex);
+        replay_sleep_until(deadline);
+        data_mutex_lock();
+    }
+    pthread_mutex_unlock(&data_mutex);
+    
+    if (t != UINT64_MAX) {
+        replay_sleep_until(t);
+    }
+}
+
+// 기록의 입력 하나를 장치에서 읽은 것처럼 처리한다
+void replay_input(const replay_event_t* e)
+{
+    if (strcmp(e->kind, "ROT") == 0) {
+        handle_rotary_event(e->data);
+    }
+    else if (strcmp(e->kind, "RTC") == 0) {
+        struct rtc_time tm;
+        apply_rtc_read(parse_rtc_time(e->data, &tm), &tm);
+    }
+    else if (strcmp(e->kind, "DHT") == 0) {
+        char buf[64];
+        size_t n = e->len < sizeof(buf) - 1 ? e->len : sizeof(buf) - 1;
+        
+        memcpy(buf, e->data, n);
+        buf[n] = '\0';
+        apply_dht11_read(strcmp(buf, "ERR") == 0 ? -1 : (int)n, buf);
+    }
+    else if (strcmp(e->kind, "HUB") == 0 && e->len == sizeof(struct sensorhub_record)) {
+        struct sensorhub_record rec;
+        memcpy(&rec, e->data, sizeof(rec));
+        apply_sensorhub(&rec);
+    }
+}
+
+/*
+ * --replay: 스레드 없이 기록의 입력을 시각 순서대로 넣고, 입력 사이에 할 일이 생기는
+ * 장치 명령 (다음 프레임, 메시지 해제) 은 그 시각에 run_next_command() 로 실행한다.
+ * 출력은 dev_oled_write()/dev_rtc_set() 에서 기록과 비교된다.
+ * 출력이 모두 같으면 0, 다르면 1
+ */
+int run_replay(const char* path)
+{
+    screen_mode_t last_mode = -1;
+    uint64_t next_frame_ns = 0;
+    size_t inputs = 0;
+    
+    if (replay_load(path) < 0 || replay.count == 0) {
+        printf("⚠ Replay: 기록을 읽을 수 없음: %s\n", path);
+        return -1;
+    }
+    
+    replay.rec_start = replay.ev[0].ts;
+    replay_clock_ns = replay.rec_start;
+    replay.real_start = now_ns();
+    
+    // 기록할 때 첫 프레임에 쓰인 NVRAM 값
+    for (size_t i = 0; i < replay.count; i++) {
+        if (strcmp(replay.ev[i].kind, "INIT") == 0) {
+            sscanf(replay.ev[i].data, "%d %d", &shared.temp, &shared.humi);
+        }
+    }
+    
+    printf("✓ Replay: %s (%zu 줄, ", path, replay.count);
+    if (replay_speed > 0) {
+        printf("%gx)\n", replay_speed);
+    } else {
+        printf("가상 시계)\n");
+    }
+    
+    for (size_t i = 0; i < replay.count; i++) {
+        replay_event_t* e = &replay.ev[i];
+        
+        if (is_output_kind(e->kind) || strcmp(e->kind, "INIT") == 0) {
+            continue;
+        }
+        replay_run_until(replay_due(e->ts), &last_mode, &next_frame_ns);
+        replay_input(e);
+        inputs++;
+    }
+    replay_run_until(UINT64_MAX, &last_mode, &next_frame_ns);
+    
+    size_t missing = replay.outputs - replay.matched - replay.mismatched;
+    
+    printf("\n=== Replay 결과 ===\n");
+    printf("입력        : %zu\n", inputs);
+    printf("출력 (기록) : %zu\n", replay.outputs);
+    printf("  일치      : %zu\n", replay.matched);
+    printf("  불일치    : %zu\n", replay.mismatched);
+    printf("  누락      : %zu\n", missing);
+    printf("  추가      : %zu\n", replay.extra);
+    if (replay.matched > 0) {
+        printf("시각 차이   : 평균 %+.3f ms, 최대 %.3f ms (재생 - 기록)\n",
+               replay.delta_sum_ns / (double)replay.matched / 1e6,
+               replay.delta_max_ns / 1e6);
+    }
+    
+    free(replay.ev);
+    
+    return (replay.mismatched || missing || replay.extra) ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
 {
+    time_data_t init_time;
+    int have_init_time = 0;
+    int sig;
+    
     printf("=== Smart Clock with Time Edit ===\n");
     
-    signal(SIGINT, signal_handler);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--event-loop") == 0) {
+            event_loop_mode = 1;
+        }
+        else if (strncmp(argv[i], "--metrics=", 10) == 0) {
+            metrics_path = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime_mode = 1;
+        }
+        else if (strncmp(argv[i], "--rt-prio=", 10) == 0) {
+            rt_prio = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--rt-cpu=", 9) == 0) {
+            rt_cpu = atoi(argv[i] + 9);
+        }
+        else if (strncmp(argv[i], "--shm=", 6) == 0) {
+            shm_name = argv[i] + 6;
+        }
+        else if (strcmp(argv[i], "--no-shm") == 0) {
+            shm_enabled = 0;
+        }
+        else if (strcmp(argv[i], "--no-sensorhub") == 0) {
+            hub_enabled = 0;
+        }
+        else if (strncmp(argv[i], "--log=", 6) == 0) {
+            log_path = argv[i] + 6;
+        }
+        else if (strncmp(argv[i], "--log-period=", 13) == 0) {
+            log_period_sec = atoi(argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--log-sync=", 11) == 0) {
+            log_sync_sec = atoi(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--record=", 9) == 0) {
+            record_path = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_path = argv[i] + 9;
+            replay_mode = 1;
+        }
+        else if (strncmp(argv[i], "--replay-speed=", 15) == 0) {
+            replay_speed = atof(argv[i] + 15);
+        }
+        // "YYMMDDhhmmss"
+        else if (strlen(argv[i]) == 12 &&
+            sscanf(argv[i], "%2d%2d%2d%2d%2d%2d",
+                   &init_time.year, &init_time.month, &init_time.day,
+                   &init_time.hour, &init_time.minute, &init_time.second) == 6) {
+            printf("초기 시간 설정: %s\n", argv[i]);
+            have_init_time = 1;
+        }
+    }
+    
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&redraw_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    
+    shared.screen_mode = SCREEN_NORMAL;
+    shared.update_display = 1;
+    shared.running = 1;
+    shared.temp = -1;
+    shared.humi = -1;
+    
+    // 재생: 장치 없이 기록만으로 돈다
+    if (replay_mode) {
+        return run_replay(replay_path);
+    }
+    
+    block_shutdown_signals();
     
     ds1302_fd = open(DEVICE_DS1302, O_RDWR);
     if (ds1302_fd < 0) {
@@ -456,24 +2334,65 @@ int main(int argc, char *argv[])
         printf("✓ DHT11 opened\n");
     }
     
-    if (argc > 1) {
-        if (strlen(argv[1]) == 12) {
-            printf("초기 시간 설정: %s\n", argv[1]);
-            write(ds1302_fd, argv[1], 12);
-            sleep(1);
+    if (have_init_time) {
+        apply_time_to_ds1302(&init_time);
+    }
+    
+    if (hub_enabled) {
+        hub_fd = open(SENSORHUB_DEVICE, O_RDONLY);
+        if (hub_fd >= 0) {
+            printf("✓ Sensor hub opened\n");
         }
     }
     
-    shared.screen_mode = SCREEN_NORMAL;
-    shared.update_display = 1;
-    shared.running = 1;
-    shared.temp = -1;
-    shared.humi = -1;
+    // 첫 DHT11 샘플 전에도 마지막 값을 바로 표시
+    if (load_nvram_state(&shared.temp, &shared.humi) == 0) {
+        printf("✓ NVRAM: 마지막 온습도 %dC / %d%%\n", shared.temp, shared.humi);
+    }
+    
+    if (record_path) {
+        if (record_open(record_path) < 0) {
+            printf("⚠ Record not available: %s\n", record_path);
+        } else {
+            char text[32];
+            printf("✓ Record: %s\n", record_path);
+            record_event("INIT", text, snprintf(text, sizeof(text), "%d %d",
+                                                shared.temp, shared.humi));
+        }
+    }
+    
+    if (dht11_fd >= 0 || hub_fd >= 0) {
+        if (sensorlog_open(log_path, LOG_CAPACITY) < 0) {
+            printf("⚠ Sensor log not available: %s\n", log_path);
+        } else {
+            printf("✓ Sensor log: %s (%u records)\n", log_path, sensorlog.hdr->capacity);
+        }
+    }
+    
+    if (shm_enabled) {
+        if (shm_publish_open() < 0) {
+            printf("⚠ Shared memory not available: %s\n", shm_name);
+        } else {
+            printf("✓ Shared memory: /dev/shm%s\n", shm_name);
+            // NVRAM 에서 복원한 온습도를 바로 보이도록
+            pthread_mutex_lock(&data_mutex);
+            shm_publish();
+            pthread_mutex_unlock(&data_mutex);
+        }
+    }
     
-    pthread_create(&thread_ds1302, NULL, ds1302_thread, NULL);
-    pthread_create(&thread_dht11, NULL, dht11_thread, NULL);
-    pthread_create(&thread_rotary, NULL, rotary_thread, NULL);
-    pthread_create(&thread_oled, NULL, oled_thread, NULL);
+    if (realtime_mode) {
+        if (rt_prio < 2) rt_prio = 2;
+        if (rt_prio > 99) rt_prio = 99;
+        realtime_setup();
+    }
+    
+    metrics_fd = metrics_listen(metrics_path);
+    if (metrics_fd < 0) {
+        printf("⚠ Metrics socket not available: %s\n", metrics_path);
+    } else {
+        printf("✓ Metrics: %s\n", metrics_path);
+    }
     
     printf("\n========================================\n");
     printf("  스마트 시계 실행 중!\n");
@@ -483,15 +2402,56 @@ int main(int argc, char *argv[])
     printf("  - Ctrl+C: 종료\n");
     printf("========================================\n\n");
     
-    pthread_join(thread_ds1302, NULL);
-    pthread_join(thread_dht11, NULL);
-    pthread_join(thread_rotary, NULL);
-    pthread_join(thread_oled, NULL);
+    if (metrics_fd >= 0) {
+        thread_create(&thread_metrics, metrics_thread);
+    }
+    
+    if (event_loop_mode) {
+        redraw_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        run_event_loop();
+        if (redraw_efd >= 0) close(redraw_efd);
+    } else {
+        thread_create(&thread_ds1302, ds1302_thread);
+        thread_create(&thread_dht11, dht11_thread);
+        thread_create(&thread_rotary, rotary_thread);
+        thread_create(&thread_device, device_thread);
+        
+        sigwait(&shutdown_sigs, &sig);
+        printf("\n종료 중...\n");
+        
+        // 장치 워커는 깨우면 스스로 끝난다 (진행 중인 OLED/RTC 쓰기는 마친다)
+        shared_write_lock();
+        shared.running = 0;
+        request_redraw(0);
+        shared_write_unlock();
+        pthread_join(thread_device, NULL);
+        
+        // 나머지는 장치 read/sleep 에서 막혀 있으므로 취소한다 (deferred: 취소 지점에서만)
+        pthread_cancel(thread_ds1302);
+        pthread_cancel(thread_dht11);
+        pthread_cancel(thread_rotary);
+        
+        pthread_join(thread_ds1302, NULL);
+        pthread_join(thread_dht11, NULL);
+        pthread_join(thread_rotary, NULL);
+    }
+    
+    if (metrics_fd >= 0) {
+        pthread_cancel(thread_metrics);
+        pthread_join(thread_metrics, NULL);
+        close(metrics_fd);
+        unlink(metrics_path);
+    }
+    
+    sensorlog_sync();
     
     close(ds1302_fd);
     close(rotary_fd);
     close(oled_fd);
     if (dht11_fd >= 0) close(dht11_fd);
+    if (hub_fd >= 0) close(hub_fd);
+    if (record_file) fclose(record_file);
     
+    printf("✓ 종료 완료\n");
     return 0;
 }
@@ -0,0 +1,414 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+/*
+ * 시뮬레이션 지연 벤치마크 (sim.sh bench 로 실행)
+ *
+ *   bench --gpio-dir=DIR [옵션] -- <app 명령...>
+ *
+ * app 을 띄우고 클릭으로 편집 모드에 들어간 뒤, gpio-sim 라인의 pull 을 바꿔 엔코더
+ * detent 를 knob-hz 로, sensorhub inject 로 온습도를 sensor-hz 로 넣는다.
+ * 커널 tracepoint (trace_clock=mono) 로 다음을 계산한다.
+ *   - knob-to-frame: detent 주입 시각 -> 그 이벤트를 read() 한 뒤 첫 oled write() 끝
+ *   - dropped      : read() 까지 오지 못한 detent (디바운스, 링 가득 참)
+ *   - I2C 바이트/프레임: oled_write_end 의 i2c_bytes 평균
+ *   - CPU          : app 의 utime+stime (/proc/PID/stat), 측정 구간 1 초당 ms
+ * 누적 모드(accumulate=1)는 detent 가 DELTA 로 합쳐지므로 끈 상태로 잰다.
+ */
+#define SENSORHUB_INJECT    "/sys/kernel/debug/sensorhub/inject"
+#define MAX_SAMPLES         65536
+
+// smartclock_sim.c 의 라인 번호
+#define LINE_S1             0
+#define LINE_S2             1
+#define LINE_SW             2
+
+const char* gpio_dir = NULL;
+const char* tracing_dir = "/sys/kernel/tracing";
+const char* app_log = "/dev/null";
+int duration_sec = 10;
+int warmup_ms = 2000;
+int knob_hz = 20;
+int sensor_hz = 1;
+int hold_us = 2000;         // S1 low 유지 시간 (rotary settle_us 보다 길어야 한다)
+
+int pull_fd[3] = {-1, -1, -1};
+int inject_fd = -1;
+
+uint64_t injected[MAX_SAMPLES];
+int n_injected;
+
+typedef struct {
+    uint64_t trace_ns;      // tracepoint 기록 시각
+    uint64_t value;         // dequeue: 에지 ts, frame: i2c_bytes
+} trace_ev_t;
+
+trace_ev_t dequeues[MAX_SAMPLES];
+int n_dequeues;
+trace_ev_t frames[MAX_SAMPLES];
+int n_frames;
+
+uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void sleep_until(uint64_t ns) {
+    struct timespec ts = { ns / 1000000000ULL, ns % 1000000000ULL };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+int write_str(const char* dir, const char* name, const char* value) {
+    char path[256];
+    int fd, ret;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    ret = write(fd, value, strlen(value));
+    close(fd);
+    return ret < 0 ? -1 : 0;
+}
+
+// gpio-sim 라인 하나를 외부에서 high/low 로 당긴다
+void set_line(int line, int high) {
+    const char* v = high ? "pull-up" : "pull-down";
+    pwrite(pull_fd[line], v, strlen(v), 0);
+}
+
+int open_lines(void) {
+    char path[256];
+
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/sim_gpio%d/pull", gpio_dir, i);
+        pull_fd[i] = open(path, O_WRONLY);
+        if (pull_fd[i] < 0) {
+            perror(path);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// detent 하나: S2 로 방향을 정하고 S1 하강 에지
+void inject_detent(int cw) {
+    set_line(LINE_S2, cw);
+    if (n_injected < MAX_SAMPLES) {
+        injected[n_injected++] = now_ns();
+    }
+    set_line(LINE_S1, 0);
+    usleep(hold_us);
+    set_line(LINE_S1, 1);
+}
+
+void inject_click(void) {
+    set_line(LINE_SW, 0);
+    usleep(30000);
+    set_line(LINE_SW, 1);
+}
+
+void inject_sensor(int n) {
+    char cmd[32];
+    int len = snprintf(cmd, sizeof(cmd), "env %d %d", 20 + n % 10, 40 + n % 20);
+
+    if (inject_fd >= 0) {
+        pwrite(inject_fd, cmd, len, 0);
+    }
+}
+
+int tracing_setup(void) {
+    if (access(tracing_dir, F_OK) != 0) {
+        tracing_dir = "/sys/kernel/debug/tracing";
+    }
+
+    if (write_str(tracing_dir, "tracing_on", "0") < 0 ||
+        write_str(tracing_dir, "trace_clock", "mono") < 0 ||
+        write_str(tracing_dir, "buffer_size_kb", "8192") < 0 ||
+        write_str(tracing_dir, "trace", "") < 0 ||
+        write_str(tracing_dir, "events/rotary/rotary_dequeue/enable", "1") < 0 ||
+        write_str(tracing_dir, "events/oled/oled_write_end/enable", "1") < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void tracing_teardown(void) {
+    write_str(tracing_dir, "tracing_on", "0");
+    write_str(tracing_dir, "events/rotary/rotary_dequeue/enable", "0");
+    write_str(tracing_dir, "events/oled/oled_write_end/enable", "0");
+}
+
+// "...  123.456789: <event>: ..." 에서 이벤트 앞의 타임스탬프 (초) 를 ns 로
+uint64_t trace_line_ns(const char* line, const char* event_pos) {
+    const char* p = event_pos;
+
+    while (p > line && p[-1] != ' ') {
+        p--;
+    }
+    return (uint64_t)(strtod(p, NULL) * 1e9);
+}
+
+int parse_trace(void) {
+    char path[256];
+    char line[512];
+    FILE* f;
+
+    snprintf(path, sizeof(path), "%s/trace", tracing_dir);
+    f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char* p;
+        unsigned long long v;
+
+        if ((p = strstr(line, ": rotary_dequeue:")) != NULL) {
+            char* ts = strstr(p, " ts=");
+            if (ts && sscanf(ts, " ts=%llu", &v) == 1 && n_dequeues < MAX_SAMPLES) {
+                dequeues[n_dequeues].trace_ns = trace_line_ns(line, p);
+                dequeues[n_dequeues].value = v;
+                n_dequeues++;
+            }
+        } else if ((p = strstr(line, ": oled_write_end:")) != NULL) {
+            char* b = strstr(p, "i2c_bytes=");
+            if (b && sscanf(b, "i2c_bytes=%llu", &v) == 1 && n_frames < MAX_SAMPLES) {
+                frames[n_frames].trace_ns = trace_line_ns(line, p);
+                frames[n_frames].value = v;
+                n_frames++;
+            }
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+// app 의 누적 CPU 시간 (ms)
+long app_cpu_ms(pid_t pid) {
+    char path[64];
+    char buf[1024];
+    unsigned long utime, stime;
+    FILE* f;
+    char* p;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    if (!fgets(buf, sizeof(buf), f)) {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    // comm 에 공백이 있을 수 있으므로 마지막 ')' 뒤부터: state 다음 11 개를 건너뛴다
+    p = strrchr(buf, ')');
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                     &utime, &stime) != 2) {
+        return -1;
+    }
+    return (long)((utime + stime) * 1000 / sysconf(_SC_CLK_TCK));
+}
+
+int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+void report(long cpu_ms, uint64_t window_ns) {
+    static uint64_t lat[MAX_SAMPLES];
+    int n_lat = 0, dropped = 0, no_frame = 0;
+    int d = 0, fr = 0;
+    uint64_t bytes = 0;
+
+    for (int i = 0; i < n_injected; i++) {
+        uint64_t t0 = injected[i];
+        uint64_t limit = t0 + (uint64_t)hold_us * 1000;
+
+        // 이 detent 의 에지 (주입 직후 hold_us 안) 를 read() 한 기록
+        while (d < n_dequeues && dequeues[d].value < t0) {
+            d++;
+        }
+        if (d >= n_dequeues || dequeues[d].value > limit) {
+            dropped++;
+            continue;
+        }
+
+        // read() 이후 처음 끝난 프레임
+        while (fr < n_frames && frames[fr].trace_ns < dequeues[d].trace_ns) {
+            fr++;
+        }
+        if (fr >= n_frames) {
+            no_frame++;
+        } else {
+            lat[n_lat++] = frames[fr].trace_ns - t0;
+        }
+        d++;
+    }
+
+    for (int i = 0; i < n_frames; i++) {
+        bytes += frames[i].value;
+    }
+
+    printf("\n=== knob-to-frame (%d s, knob %d Hz, sensor %d Hz) ===\n",
+           duration_sec, knob_hz, sensor_hz);
+    printf("injected detents : %d\n", n_injected);
+    printf("dropped          : %d\n", dropped);
+    printf("no frame         : %d\n", no_frame);
+    if (n_lat > 0) {
+        qsort(lat, n_lat, sizeof(lat[0]), cmp_u64);
+        printf("latency p50      : %.1f us\n", lat[n_lat / 2] / 1000.0);
+        printf("latency p99      : %.1f us\n", lat[(n_lat * 99) / 100] / 1000.0);
+        printf("latency max      : %.1f us\n", lat[n_lat - 1] / 1000.0);
+    }
+    printf("frames           : %d (%.1f/s)\n", n_frames, n_frames * 1e9 / window_ns);
+    if (n_frames > 0) {
+        printf("I2C bytes/frame  : %.1f\n", (double)bytes / n_frames);
+    }
+    if (cpu_ms >= 0) {
+        printf("app CPU          : %.1f ms/s\n", cpu_ms * 1e9 / window_ns);
+    }
+}
+
+void usage(const char* prog) {
+    printf("usage: %s --gpio-dir=DIR [options] -- <app command...>\n"
+           "  --duration=SEC   측정 시간 (기본 %d)\n"
+           "  --knob-hz=N      초당 detent 수 (기본 %d, rotary debounce_us 보다 느려야 함)\n"
+           "  --sensor-hz=N    초당 온습도 주입 수 (기본 %d, 0: 끔)\n"
+           "  --hold-us=N      S1 low 유지 시간 (기본 %d)\n"
+           "  --warmup-ms=N    app 시작 후 대기 (기본 %d)\n"
+           "  --app-log=PATH   app 출력 (기본 /dev/null)\n",
+           prog, duration_sec, knob_hz, sensor_hz, hold_us, warmup_ms);
+}
+
+int main(int argc, char* argv[])
+{
+    char** app_argv = NULL;
+    uint64_t start, end, next_knob, next_sensor;
+    long cpu_start, cpu_end;
+    int status;
+    pid_t pid;
+    int n_sensor = 0;
+    int cw = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--") == 0) {
+            app_argv = &argv[i + 1];
+            break;
+        }
+        else if (strncmp(argv[i], "--gpio-dir=", 11) == 0) {
+            gpio_dir = argv[i] + 11;
+        }
+        else if (strncmp(argv[i], "--duration=", 11) == 0) {
+            duration_sec = atoi(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--knob-hz=", 10) == 0) {
+            knob_hz = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--sensor-hz=", 12) == 0) {
+            sensor_hz = atoi(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--hold-us=", 10) == 0) {
+            hold_us = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--warmup-ms=", 12) == 0) {
+            warmup_ms = atoi(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--app-log=", 10) == 0) {
+            app_log = argv[i] + 10;
+        }
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!gpio_dir || !app_argv || !app_argv[0] || knob_hz <= 0 || duration_sec <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (open_lines() < 0 || tracing_setup() < 0) {
+        return 1;
+    }
+
+    inject_fd = open(SENSORHUB_INJECT, O_WRONLY);
+    if (inject_fd < 0 && sensor_hz > 0) {
+        perror(SENSORHUB_INJECT);
+    }
+
+    // 엔코더 idle 상태
+    set_line(LINE_S1, 1);
+    set_line(LINE_SW, 1);
+
+    pid = fork();
+    if (pid == 0) {
+        int fd = open(app_log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+        execvp(app_argv[0], app_argv);
+        perror(app_argv[0]);
+        _exit(127);
+    }
+
+    usleep(warmup_ms * 1000);
+
+    // 편집 모드에 들어가야 회전이 화면을 바꾼다
+    inject_click();
+    usleep(300000);
+
+    write_str(tracing_dir, "tracing_on", "1");
+    cpu_start = app_cpu_ms(pid);
+    start = now_ns();
+    end = start + (uint64_t)duration_sec * 1000000000ULL;
+    next_knob = start;
+    next_sensor = sensor_hz > 0 ? start : UINT64_MAX;
+
+    while (next_knob < end || next_sensor < end) {
+        if (next_knob <= next_sensor) {
+            sleep_until(next_knob);
+            inject_detent(cw);
+            cw = !cw;       // 번갈아 돌려 값이 한쪽으로 흘러가지 않게
+            next_knob += 1000000000ULL / knob_hz;
+        } else {
+            sleep_until(next_sensor);
+            inject_sensor(n_sensor++);
+            next_sensor += 1000000000ULL / sensor_hz;
+        }
+    }
+
+    // 마지막 detent 의 프레임까지 기다린다
+    usleep(200000);
+    cpu_end = app_cpu_ms(pid);
+    end = now_ns();
+    write_str(tracing_dir, "tracing_on", "0");
+
+    kill(pid, SIGINT);
+    waitpid(pid, &status, 0);
+
+    parse_trace();
+    tracing_teardown();
+
+    report(cpu_start >= 0 && cpu_end >= 0 ? cpu_end - cpu_start : -1, end - start);
+
+    return 0;
+}
@@ -9,12 +9,24 @@
 #include <linux/uaccess.h>
 #include <linux/device.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/notifier.h>
+
+#include "sensorhub.h"
+
+#define CREATE_TRACE_POINTS
+#include "dht11_trace.h"
 
 #define DEVICE_NAME "dht11"
 #define CLASS_NAME "dht11_class"
 
 #define GPIO_PIN  4
 
+// 측정 사이 최소 간격. 그 안의 요청은 마지막 결과를 그대로 돌려준다
+#define DHT11_MIN_INTERVAL_MS	2000
+
 /* 메타 정보 */
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("kkk");
@@ -24,6 +36,28 @@ static dev_t dev_num;
 static struct cdev dht11_cdev;
 static struct class *dht11_class = NULL;
 
+/*
+ * read() 와 백그라운드 측정이 동시에 핀을 건드리지 않도록. 측정마다 인터럽트를 수 ms
+ * 막으므로 마지막 측정 결과(dht11_last_*)도 이 락으로 보호하고 최소 간격을 둔다.
+ */
+static DEFINE_MUTEX(dht11_lock);
+static bool dht11_has_sample;
+static unsigned long dht11_last_jiffies;
+static int dht11_last_ret;
+static int dht11_last_temp;
+static int dht11_last_humi;
+
+/*
+ * 백그라운드 측정: /dev/sensorhub 를 연 사용자가 있는 동안 sample_ms 마다 (최소
+ * DHT11_MIN_INTERVAL_MS) 한 번 읽어 넣는다. 0 이면 끄고 read() 할 때만 측정한다
+ * (이때도 결과는 sensorhub 에 반영된다).
+ */
+static unsigned int sample_ms = 3000;
+module_param(sample_ms, uint, 0644);
+MODULE_PARM_DESC(sample_ms, "Background sampling period for /dev/sensorhub in milliseconds (0 = off)");
+
+static struct delayed_work dht11_sample_work;
+
 static int wait_pin_status(int level, int time_us)
 {
 	int counter = 0;
@@ -39,33 +73,19 @@ static int wait_pin_status(int level, int time_us)
 	return counter;
 }
 
-static int read_dht11(int *temp, int *humi)
+/* 인터럽트를 막은 상태에서 호출: 응답 신호와 40 비트를 읽는다 */
+static int read_dht11_frame(unsigned char *data)
 {
-	unsigned char data[6] = {0};
-	unsigned long flags;
-
-	gpio_direction_output(GPIO_PIN, 0);
-	msleep(20);
-	gpio_set_value(GPIO_PIN, 1);
-	udelay(30);
-
-	gpio_direction_input(GPIO_PIN);
-	udelay(2);
-
-	local_irq_save(flags); // 인터럽트 비활성화
-	// ... 타이밍이 중요한 데이터 읽기 루프 ...
 	// 1. check DHT11 response : LOW(80us) --> HIGH(80us)
 	wait_pin_status(0, 200);
 	if(wait_pin_status(1, 200) < 0)
 	{
-		local_irq_restore(flags);
 		return -1;
 	}
 
 	// 2. wait for the start of the first data bit (low 50us)
 	if(wait_pin_status(0, 200) < 0)
 	{
-		local_irq_restore(flags);
 		return -1;
 	}
 	for(int i = 0; i < 40; i++)
@@ -73,7 +93,6 @@ static int read_dht11(int *temp, int *humi)
 		// wait for high level of data bits
 		if(wait_pin_status(1,200) < 0)
 		{
-			local_irq_restore(flags);
 			return -1;
 		}
 		udelay(35);		// 0과 1의 차이
@@ -84,34 +103,131 @@ static int read_dht11(int *temp, int *humi)
 			// wait until high ends
 			if(wait_pin_status(0, 200) < 0)
 			{
-				local_irq_restore(flags);
 				return -1;
 			}
 		}
 	}
 
+	return 0;
+}
+
+static int read_dht11(int *temp, int *humi)
+{
+	unsigned char data[6] = {0};
+	unsigned long flags;
+	ktime_t irq_start;
+	s64 irq_off_ns;
+	int ret;
+
+	trace_dht11_read_start(GPIO_PIN);
+
+	gpio_direction_output(GPIO_PIN, 0);
+	msleep(20);
+	gpio_set_value(GPIO_PIN, 1);
+	udelay(30);
+
+	gpio_direction_input(GPIO_PIN);
+	udelay(2);
+
+	local_irq_save(flags); // 인터럽트 비활성화
+	irq_start = ktime_get();
+	ret = read_dht11_frame(data);
+	irq_off_ns = ktime_to_ns(ktime_sub(ktime_get(), irq_start));
 	local_irq_restore(flags); // 인터럽트 복구
 
-	if(data[4] == ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+	if(ret == 0 && data[4] != ((data[0] + data[1] + data[2] + data[3]) & 0xFF))
+	{
+		ret = -1;
+	}
+
+	if(ret == 0)
 	{
 		*humi = data[0];
 		*temp = data[2];
 	}
+
+	trace_dht11_read_end(ret, data[2], data[0], irq_off_ns);
+
+	return ret;
+}
+
+/*
+ * 한 번 측정하고 결과를 sensorhub 에 넣는다. 마지막 측정에서 DHT11_MIN_INTERVAL_MS 가
+ * 지나지 않았으면 측정하지 않고 그 결과를 돌려준다 (sensorhub 에도 다시 넣지 않는다).
+ */
+static int dht11_sample(int *temp, int *humi)
+{
+	int ret;
+
+	mutex_lock(&dht11_lock);
+	if(dht11_has_sample &&
+	   time_before(jiffies, dht11_last_jiffies + msecs_to_jiffies(DHT11_MIN_INTERVAL_MS)))
+	{
+		*temp = dht11_last_temp;
+		*humi = dht11_last_humi;
+		ret = dht11_last_ret;
+		mutex_unlock(&dht11_lock);
+		return ret;
+	}
+
+	ret = read_dht11(temp, humi);
+
+	dht11_has_sample = true;
+	dht11_last_jiffies = jiffies;
+	dht11_last_ret = ret;
+	dht11_last_temp = *temp;
+	dht11_last_humi = *humi;
+	mutex_unlock(&dht11_lock);
+
+	sensorhub_publish_env(*temp, *humi, ret == 0);
+
+	return ret;
+}
+
+static void dht11_sample_work_fn(struct work_struct *work)
+{
+	unsigned int period = READ_ONCE(sample_ms);
+	int temp = 0, humi = 0;
+
+	// 꺼져 있으면 다시 켜질 때까지 1 초마다 확인만 한다
+	if(period)
+	{
+		dht11_sample(&temp, &humi);
+	}
 	else
 	{
-		return -1;
+		period = 1000;
 	}
+	schedule_delayed_work(&dht11_sample_work,
+						  msecs_to_jiffies(max(period, (unsigned int)DHT11_MIN_INTERVAL_MS)));
+}
 
-	return 0;
+/* sensorhub 사용자가 생기면 바로 측정을 시작하고, 없어지면 멈춘다 */
+static int dht11_hub_event(struct notifier_block *nb, unsigned long event, void *data)
+{
+	if(event == SENSORHUB_ACTIVE)
+	{
+		schedule_delayed_work(&dht11_sample_work, 0);
+	}
+	else if(event == SENSORHUB_IDLE)
+	{
+		cancel_delayed_work_sync(&dht11_sample_work);
+	}
+
+	return NOTIFY_OK;
 }
 
+static struct notifier_block dht11_hub_nb = {
+	.notifier_call = dht11_hub_event,
+};
+
 static ssize_t dht11_dev_read(struct file *filep, char __user *buffer, size_t len, loff_t *offset)
 {
 	int temp = 0, humi = 0;
 	int ret;
 	char msg_buff[80];
 
-	ret = read_dht11(&temp, &humi);
+	ret = dht11_sample(&temp, &humi);
 	if(ret == 0)
 	{
 		sprintf(msg_buff, "Temp : %d c, Humi : %d %%\n", temp, humi);
@@ -170,11 +286,26 @@ static int __init dht11_driver_init(void) {
     return -1;
   }
 
+  // 5. background sampling while /dev/sensorhub has readers
+  INIT_DELAYED_WORK(&dht11_sample_work, dht11_sample_work_fn);
+  ret = sensorhub_register_notifier(&dht11_hub_nb);
+  if (ret) {
+    printk(KERN_ERR "ERROR: sensorhub_register_notifier  ........\n");
+    gpio_free(GPIO_PIN);
+    device_destroy(dht11_class, dev_num);
+    class_destroy(dht11_class);
+    cdev_del(&dht11_cdev);
+    unregister_chrdev_region(dev_num, 1);
+    return ret;
+  }
+
   printk(KERN_INFO "dht11 driver init success ........\n");
   return 0;
 }
 
 static void __exit dht11_driver_exit(void) {
+  sensorhub_unregister_notifier(&dht11_hub_nb);
+  cancel_delayed_work_sync(&dht11_sample_work);
   gpio_free(GPIO_PIN);
   device_destroy(dht11_class, dev_num);
   class_destroy(dht11_class);
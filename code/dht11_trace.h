@@ -0,0 +1,61 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM dht11
+
+#if !defined(_DHT11_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _DHT11_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * DHT11 측정 tracepoint (/sys/kernel/tracing/events/dht11/)
+ *   dht11_read_start : 시작 신호(20ms LOW) 직전
+ *   dht11_read_end   : 결과. irq_off_ns 는 40 비트를 읽는 동안 인터럽트를 막은 시간
+ */
+TRACE_EVENT(dht11_read_start,
+
+	TP_PROTO(int gpio),
+
+	TP_ARGS(gpio),
+
+	TP_STRUCT__entry(
+		__field(int, gpio)
+	),
+
+	TP_fast_assign(
+		__entry->gpio = gpio;
+	),
+
+	TP_printk("gpio=%d", __entry->gpio)
+);
+
+TRACE_EVENT(dht11_read_end,
+
+	TP_PROTO(int ret, int temp, int humi, s64 irq_off_ns),
+
+	TP_ARGS(ret, temp, humi, irq_off_ns),
+
+	TP_STRUCT__entry(
+		__field(int, ret)
+		__field(int, temp)
+		__field(int, humi)
+		__field(s64, irq_off_ns)
+	),
+
+	TP_fast_assign(
+		__entry->ret = ret;
+		__entry->temp = temp;
+		__entry->humi = humi;
+		__entry->irq_off_ns = irq_off_ns;
+	),
+
+	TP_printk("ret=%d temp=%d humi=%d irq_off_ns=%lld",
+			  __entry->ret, __entry->temp, __entry->humi, __entry->irq_off_ns)
+);
+
+#endif /* _DHT11_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE dht11_trace
+#include <trace/define_trace.h>
@@ -1,19 +1,39 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
-#include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/delay.h>
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
-#include <linux/timer.h>
 #include <linux/jiffies.h>
 #include <linux/device.h>
-
-// ========= GPIO PIN =========
-#define GPIO_CLK	17
-#define GPIO_DAT	18
-#define GPIO_RST	19
+#include <linux/platform_device.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
+#include <linux/rtc.h>
+#include <linux/hrtimer.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/nvmem-provider.h>
+#include <linux/mod_devicetable.h>
+#include <linux/debugfs.h>
+#include <linux/notifier.h>
+#include <linux/seq_file.h>
+
+#include "sensorhub.h"
+
+#define CREATE_TRACE_POINTS
+#include "ds1302_trace.h"
+
+// ========= GPIO (device tree) =========
+// bus-gpios = <CLK>, <IO>;  ce-gpios = <CE>;
+#define BUS_CLK		0
+#define BUS_IO		1
 
 // ========= ADDRESS =========
 #define ADDR_SECONDS		0x80
@@ -23,10 +43,21 @@
 #define ADDR_MONTH			0x88
 #define ADDR_DAYOFWEEK		0x8A
 #define ADDR_YEAR			0x8C
+#define ADDR_CONTROL		0x8E
 
-#define DEVICE_NAME 	"ds1302"
+// ========= BURST =========
+// 클럭 레지스터 8개(초~WP)를 한 번의 CE 구간에서 읽고/쓴다
+#define CMD_CLOCK_BURST		0xBE
+#define CLOCK_BURST_LEN		8
+
+// 배터리 백업 RAM 31 바이트도 burst 로 한 번에 접근한다
+#define CMD_RAM_BURST		0xFE
+#define RAM_SIZE			31
 
-#define BLINK_PERIOD_MS 1000
+#define SECONDS_CH			0x80	// Clock Halt
+#define CONTROL_WP			0x80	// Write Protect
+
+#define DEVICE_NAME 	"ds1302"
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Driver Developer");
@@ -36,7 +67,98 @@ static dev_t device_number;
 static struct cdev ds1302_cdev;
 static struct class *ds1302_class = NULL;
 static struct device *ds1302_device = NULL;
-static struct timer_list ds1302_timer;
+
+/*
+ * 시간 캐시: 하드웨어에서 읽은 시각(cache_secs)과 그 순간의 ktime(cache_anchor)만
+ * 저장하고, 읽을 때는 앵커 이후 흐른 시간을 더해 계산한다. read() 는 GPIO 를 전혀
+ * 건드리지 않고 seqlock 으로 일관된 값을 얻는다.
+ * ds1302_lock 은 3-wire 버스를 보호하고, 캐시 갱신은 그 안에서 ds1302_seq 를 irqsave 로
+ * 잡는다. 틱 타이머 (softirq) 가 같은 CPU 에서 쓰기 도중에 끼어들어 홀수 seq 를 읽으며
+ * 영원히 도는 일이 없도록 writer 는 인터럽트를 막는다.
+ */
+static DEFINE_MUTEX(ds1302_lock);
+static DEFINE_SEQLOCK(ds1302_seq);
+static time64_t cache_secs;
+static ktime_t cache_anchor;
+static bool cache_valid;
+
+// 시간을 쓸 때마다 증가 (ds1302_lock 보호). resync 가 초 경계를 기다리는 중에 바뀌면 다시 잰다
+static unsigned int ds1302_set_count;
+
+// 하드웨어와 다시 맞추는 주기 (초)
+static unsigned int resync_sec = 60;
+module_param(resync_sec, uint, 0644);
+MODULE_PARM_DESC(resync_sec, "Interval between hardware resyncs of the cached time, in seconds");
+
+static struct delayed_work ds1302_resync_work;
+
+/*
+ * 초 틱: 캐시 앵커 기준으로 계산한 초 경계마다 hrtimer (softirq) 가 ds1302_tick 을 올리고
+ * 대기 중인 reader 를 깨운다. 장치를 연 사용자가 있을 때만 동작한다.
+ * /dev/sensorhub 를 연 사용자가 있는 동안은 sensorhub 도 사용자 하나로 센다 (ds1302_hub_nb).
+ */
+static struct hrtimer ds1302_tick_timer;
+static atomic_long_t ds1302_tick = ATOMIC_LONG_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(ds1302_wait);
+static DEFINE_MUTEX(ds1302_open_lock);
+static int ds1302_users;
+
+/*
+ * remove 된 뒤 true. GPIO 디스크립터는 devm 으로 해제되지만 열린 파일은 남아 있으므로,
+ * fops 는 -ENODEV 를 돌려주고 GPIO 를 건드리는 곳은 ds1302_lock 안에서 확인한다.
+ * ds1302_lock 과 ds1302_open_lock 을 모두 잡고 바꾼다.
+ */
+static bool ds1302_dead;
+
+// 파일마다 마지막으로 읽은 틱
+struct ds1302_file {
+	long seen_tick;
+};
+
+static void ds1302_tick_rearm(void);
+
+static struct gpio_descs *ds1302_bus;
+static struct gpio_desc *ds1302_ce;
+
+/*
+ * 데이터시트 AC 특성 (ns). VCC 2.0V 기준이 기본이고, 5V 로 구동하는 보드는
+ * fast_timing=1 로 약 4 배 빠른 값을 쓴다.
+ *   tcl/tch : CLK low/high 폭, tcdd : CLK 하강 -> 데이터 출력 지연,
+ *   tcc : CE -> CLK 셋업, tcwh : CE 비활성 시간
+ */
+struct ds1302_timing {
+	unsigned int tcl;
+	unsigned int tch;
+	unsigned int tcdd;
+	unsigned int tcc;
+	unsigned int tcwh;
+};
+
+static const struct ds1302_timing ds1302_timing_2v = {
+	.tcl = 1000, .tch = 1000, .tcdd = 800, .tcc = 4000, .tcwh = 4000,
+};
+
+static const struct ds1302_timing ds1302_timing_5v = {
+	.tcl = 250, .tch = 250, .tcdd = 200, .tcc = 1000, .tcwh = 1000,
+};
+
+static bool fast_timing;
+module_param(fast_timing, bool, 0644);
+MODULE_PARM_DESC(fast_timing, "Use the 5V datasheet timing instead of the 2V one");
+
+static struct dentry *ds1302_debugfs;
+
+static struct rtc_device *ds1302_rtc;
+
+/*
+ * RTC 알람 에뮬레이션: 칩에 알람이 없으므로 초 틱과 같은 방식으로 캐시 앵커 기준 초 경계에
+ * hrtimer (softirq) 를 건다. 앵커가 바뀌면 ds1302_tick_rearm() 이 다시 맞춘다.
+ * ds1302_alarm_enabled 는 ds1302_alarm_lock 으로 보호한다.
+ */
+static struct hrtimer ds1302_alarm_timer;
+static DEFINE_MUTEX(ds1302_alarm_lock);
+static bool ds1302_alarm_enabled;
+static time64_t ds1302_alarm_time;
 
 typedef struct {
 	uint8_t seconds;
@@ -48,8 +170,6 @@ typedef struct {
 	uint8_t year;
 }t_ds1302;
 
-static t_ds1302 ds_time;
-
 static unsigned char bcd2dec(unsigned char byte)
 {
 	uint8_t high, low;
@@ -60,6 +180,12 @@ static unsigned char bcd2dec(unsigned char byte)
 	return (high + low);
 }
 
+/* 두 자리 모두 0~9 인 BCD 인지 */
+static bool bcd_valid(unsigned char byte)
+{
+	return (byte & 0x0F) <= 9 && (byte >> 4) <= 9;
+}
+
 static unsigned char dec2bcd(unsigned char byte)
 {
 	unsigned char high, low;
@@ -70,123 +196,613 @@ static unsigned char dec2bcd(unsigned char byte)
 	return (high + low);
 }
 
-static void ds1302_DataLine_Input(void)
+/*
+ * 3-wire 전송. 쓰기 비트는 CLK 하강과 DATA 변경을 gpiod_set_array_value_cansleep 한 번으로
+ * 같이 내보내고, 상승 에지에서 칩이 샘플링한다. 읽기는 명령 바이트 뒤에 IO 방향을
+ * 한 번만 바꾸고, 각 하강 에지 후 tCDD 를 기다렸다가 샘플링한다.
+ * 모든 지연은 현재 타이밍 표(2V/5V)의 ns 값이다.
+ * 항상 ds1302_lock (mutex) 안, 프로세스 문맥이므로 _cansleep 접근자를 쓴다 (I2C 확장 칩,
+ * gpio-sim 처럼 잠들 수 있는 GPIO 컨트롤러도 쓸 수 있다).
+ */
+static void ds1302_bus_set(int clk, int io)
 {
-	gpio_direction_input(GPIO_DAT);
+	unsigned long values = (clk << BUS_CLK) | (io << BUS_IO);
+
+	gpiod_set_array_value_cansleep(ds1302_bus->ndescs, ds1302_bus->desc, ds1302_bus->info, &values);
 }
 
-static void ds1302_DataLine_Output(void)
+static const struct ds1302_timing *ds1302_begin(void)
 {
-	gpio_direction_output(GPIO_DAT, 0);
+	const struct ds1302_timing *tp = fast_timing ? &ds1302_timing_5v : &ds1302_timing_2v;
+
+	gpiod_direction_output(ds1302_bus->desc[BUS_IO], 0);
+	gpiod_set_value_cansleep(ds1302_ce, 1);
+	ndelay(tp->tcc);
+
+	return tp;
 }
 
-static void ds1302_clock(void)
+static void ds1302_end(const struct ds1302_timing *tp)
 {
-	gpio_set_value(GPIO_CLK, 1);
-	udelay(2);
-	gpio_set_value(GPIO_CLK, 0);
-	udelay(2);
+	gpiod_set_value_cansleep(ds1302_bus->desc[BUS_CLK], 0);
+	gpiod_set_value_cansleep(ds1302_ce, 0);
+	ndelay(tp->tcwh);
 }
 
-static void ds1302_tx(uint8_t tx)
+static void ds1302_tx(const struct ds1302_timing *tp, uint8_t tx)
 {
-	ds1302_DataLine_Output();
-
 	for(int i = 0; i < 8; i++)
 	{
-		if(tx & (1 << i))
-		{
-			gpio_set_value(GPIO_DAT, 1);
-		}
-		else
-		{
-			gpio_set_value(GPIO_DAT, 0);
-		}
-		ds1302_clock();
+		ds1302_bus_set(0, (tx >> i) & 1);
+		ndelay(tp->tcl);
+		gpiod_set_value_cansleep(ds1302_bus->desc[BUS_CLK], 1);
+		ndelay(tp->tch);
 	}
 }
 
-static void ds1302_rx(uint8_t *data8)
+/*
+ * 명령의 마지막 비트 뒤 CLK 는 high 로 남아 있고, 다음 하강 에지마다 칩이 한 비트씩
+ * 내보낸다. burst 도 같은 순서라 마지막 바이트를 따로 처리할 필요가 없다.
+ */
+static uint8_t ds1302_rx(const struct ds1302_timing *tp)
 {
 	uint8_t temp = 0;
 
-	ds1302_DataLine_Input();
-
 	for(int i = 0; i < 8; i++)
 	{
-		if(gpio_get_value(GPIO_DAT))
+		gpiod_set_value_cansleep(ds1302_bus->desc[BUS_CLK], 0);
+		ndelay(max(tp->tcl, tp->tcdd));
+		if(gpiod_get_value_cansleep(ds1302_bus->desc[BUS_IO]) > 0)
 		{
 			temp |= 1 << i;
 		}
-		if(i != 7)
-		{
-			ds1302_clock();
-		}
+		gpiod_set_value_cansleep(ds1302_bus->desc[BUS_CLK], 1);
+		ndelay(tp->tch);
 	}
-	*data8 = temp;
+
+	return temp;
+}
+
+/* tracepoint 용 CE 구간 길이 */
+static s64 ds1302_xfer_ns(ktime_t start)
+{
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
 }
 
 static void ds1302_write_byte(uint8_t addr, uint8_t data)
 {
-	gpio_set_value(GPIO_RST, 1);
-	ds1302_tx(addr);
-	ds1302_tx(dec2bcd(data));
-	gpio_set_value(GPIO_RST, 0);
+	ktime_t start = ktime_get();
+	const struct ds1302_timing *tp = ds1302_begin();
+
+	ds1302_tx(tp, addr);
+	ds1302_tx(tp, data);
+	ds1302_end(tp);
+
+	trace_ds1302_write_byte(addr, 1, data, ds1302_xfer_ns(start));
 }
 
 static uint8_t ds1302_read_byte(uint8_t addr)
 {
-	uint8_t data8bits = 0;
+	ktime_t start = ktime_get();
+	const struct ds1302_timing *tp = ds1302_begin();
+	uint8_t data8bits;
+
+	ds1302_tx(tp, addr + 1);
+	gpiod_direction_input(ds1302_bus->desc[BUS_IO]);
+	data8bits = ds1302_rx(tp);
+	ds1302_end(tp);
+
+	trace_ds1302_read_byte(addr + 1, 1, data8bits, ds1302_xfer_ns(start));
+
+	return data8bits;
+}
+
+static void ds1302_read_burst(uint8_t cmd, uint8_t *buf, int len)
+{
+	ktime_t start = ktime_get();
+	const struct ds1302_timing *tp = ds1302_begin();
+
+	ds1302_tx(tp, cmd + 1);
+	gpiod_direction_input(ds1302_bus->desc[BUS_IO]);
+	for(int i = 0; i < len; i++)
+	{
+		buf[i] = ds1302_rx(tp);
+	}
+	ds1302_end(tp);
+
+	trace_ds1302_read_burst(cmd + 1, len, len ? buf[0] : 0, ds1302_xfer_ns(start));
+}
+
+static void ds1302_write_burst(uint8_t cmd, const uint8_t *buf, int len)
+{
+	ktime_t start = ktime_get();
+	const struct ds1302_timing *tp = ds1302_begin();
 
-	gpio_set_value(GPIO_RST, 1);
-	ds1302_tx(addr + 1);
-	ds1302_rx(&data8bits);
-	gpio_set_value(GPIO_RST, 0);
+	ds1302_tx(tp, cmd);
+	for(int i = 0; i < len; i++)
+	{
+		ds1302_tx(tp, buf[i]);
+	}
+	ds1302_end(tp);
 
-	return bcd2dec(data8bits);
+	trace_ds1302_write_burst(cmd, len, len ? buf[0] : 0, ds1302_xfer_ns(start));
 }
 
-static void ds1302_init_time_date(void)
+/*
+ * WP 를 풀고 8 바이트를 한 번에 쓴다. 마지막 바이트(control)로 WP 를 다시 건다.
+ * 초 레지스터의 CH 비트는 0 으로 써서 클럭을 계속 동작시킨다.
+ */
+static void ds1302_init_time_date(const t_ds1302 *t)
 {
-	ds1302_write_byte(ADDR_SECONDS, ds_time.seconds);
-	ds1302_write_byte(ADDR_MINUTES, ds_time.minutes);
-	ds1302_write_byte(ADDR_HOURS, ds_time.hours);
-	ds1302_write_byte(ADDR_DATE, ds_time.date);
-	ds1302_write_byte(ADDR_MONTH, ds_time.month);
-	ds1302_write_byte(ADDR_DAYOFWEEK, ds_time.dayofweek);
-	ds1302_write_byte(ADDR_YEAR, ds_time.year);
+	uint8_t regs[CLOCK_BURST_LEN];
+
+	regs[0] = dec2bcd(t->seconds) & ~SECONDS_CH;
+	regs[1] = dec2bcd(t->minutes);
+	regs[2] = dec2bcd(t->hours);		// 24시간 모드
+	regs[3] = dec2bcd(t->date);
+	regs[4] = dec2bcd(t->month);
+	regs[5] = dec2bcd(t->dayofweek);
+	regs[6] = dec2bcd(t->year);
+	regs[7] = CONTROL_WP;
+
+	lockdep_assert_held(&ds1302_lock);
+	ds1302_write_byte(ADDR_CONTROL, 0x00);
+	ds1302_write_burst(CMD_CLOCK_BURST, regs, CLOCK_BURST_LEN);
 }
 
-static void ds1302_read_time(void)
+/*
+ * 한 번의 CE 구간에서 읽으므로 분/시 경계에서도 값이 찢어지지 않는다.
+ * 칩이 멈춰 있거나(CH=1, 배터리 없이 전원이 끊겼던 경우) 레지스터가 날짜로 읽히지 않으면
+ * (BCD 가 아닌 자리, 0 월/0 일 등. 칩이 없어 IO 가 한쪽으로 고정된 경우 포함) true 를 돌려준다.
+ */
+static bool ds1302_read_time_date(t_ds1302 *t)
 {
-	ds_time.seconds = ds1302_read_byte(ADDR_SECONDS);
-	ds_time.minutes = ds1302_read_byte(ADDR_MINUTES);
-	ds_time.hours = ds1302_read_byte(ADDR_HOURS);
+	uint8_t regs[CLOCK_BURST_LEN];
+	bool bad = false;
+
+	lockdep_assert_held(&ds1302_lock);
+	ds1302_read_burst(CMD_CLOCK_BURST, regs, CLOCK_BURST_LEN);
+
+	bad |= !bcd_valid(regs[0] & 0x7F) || !bcd_valid(regs[1] & 0x7F);
+	bad |= !bcd_valid(regs[2] & 0x3F) || !bcd_valid(regs[3] & 0x3F);
+	bad |= !bcd_valid(regs[4] & 0x1F) || !bcd_valid(regs[6]);
+
+	t->seconds = bcd2dec(regs[0] & 0x7F);
+	t->minutes = bcd2dec(regs[1] & 0x7F);
+	t->hours = bcd2dec(regs[2] & 0x3F);
+	t->date = bcd2dec(regs[3] & 0x3F);
+	t->month = bcd2dec(regs[4] & 0x1F);
+	t->dayofweek = bcd2dec(regs[5] & 0x07);
+	t->year = bcd2dec(regs[6]);
+
+	bad |= t->seconds > 59 || t->minutes > 59 || t->hours > 23;
+	bad |= t->month < 1 || t->month > 12 ||
+		   t->date < 1 || t->date > rtc_month_days(t->month - 1, 2000 + t->year);
+
+	return (regs[0] & SECONDS_CH) || bad;
+}
+
+/* dayofweek 는 1(일요일) ~ 7 로 사용한다 */
+static void ds1302_to_rtc_time(const t_ds1302 *t, struct rtc_time *tm)
+{
+	tm->tm_sec = t->seconds;
+	tm->tm_min = t->minutes;
+	tm->tm_hour = t->hours;
+	tm->tm_mday = t->date;
+	tm->tm_mon = t->month - 1;
+	tm->tm_year = t->year + 100;
+	tm->tm_wday = (t->dayofweek >= 1 && t->dayofweek <= 7) ? t->dayofweek - 1 : 0;
 }
 
-static void ds1302_read_date(void)
+static void rtc_time_to_ds1302(const struct rtc_time *tm, t_ds1302 *t)
 {
-	ds_time.date = ds1302_read_byte(ADDR_DATE);
-	ds_time.month = ds1302_read_byte(ADDR_MONTH);
-	ds_time.dayofweek = ds1302_read_byte(ADDR_DAYOFWEEK);
-	ds_time.year = ds1302_read_byte(ADDR_YEAR);
+	t->seconds = tm->tm_sec;
+	t->minutes = tm->tm_min;
+	t->hours = tm->tm_hour;
+	t->date = tm->tm_mday;
+	t->month = tm->tm_mon + 1;
+	t->year = tm->tm_year - 100;
+	t->dayofweek = tm->tm_wday + 1;
+}
+
+/* ds1302_lock 을 잡은 상태에서 호출 */
+static void ds1302_update_cache(const struct rtc_time *tm, ktime_t anchor, bool valid)
+{
+	unsigned long flags;
+
+	lockdep_assert_held(&ds1302_lock);
+
+	write_seqlock_irqsave(&ds1302_seq, flags);
+	cache_secs = rtc_tm_to_time64(tm);
+	cache_anchor = anchor;
+	cache_valid = valid;
+	write_sequnlock_irqrestore(&ds1302_seq, flags);
+}
+
+/*
+ * 하드웨어에서 시간을 다시 읽어 캐시를 갱신한다. wait_edge 이면 초 레지스터가
+ * 바뀌는 순간(초 경계)까지 기다린 뒤 앵커를 잡으므로 외삽 값의 위상 오차가 ms 수준이 된다.
+ * 기다리는 최대 1.1 초 동안은 폴링 사이마다 ds1302_lock 을 놓아 RTC_SET_TIME, nvmem,
+ * rtc-class 가 막히지 않게 하고, 경계를 본 폴링부터 캐시 갱신까지만 잠금을 이어서 잡는다.
+ */
+static void ds1302_resync(bool wait_edge)
+{
+	struct rtc_time tm;
+	ktime_t anchor, deadline;
+	unsigned int set_count;
+	uint8_t prev, sec;
+	t_ds1302 t;
+	bool halted;
+
+	mutex_lock(&ds1302_lock);
+
+	if(ds1302_dead)
+	{
+		mutex_unlock(&ds1302_lock);
+		return;
+	}
+
+	if(wait_edge)
+	{
+		prev = ds1302_read_byte(ADDR_SECONDS);
+		set_count = ds1302_set_count;
+		deadline = ktime_add_ms(ktime_get(), 1100);
+		for(;;)
+		{
+			mutex_unlock(&ds1302_lock);
+			usleep_range(1000, 1500);
+			mutex_lock(&ds1302_lock);
+
+			if(ds1302_dead)
+			{
+				mutex_unlock(&ds1302_lock);
+				return;
+			}
+
+			sec = ds1302_read_byte(ADDR_SECONDS);
+
+			// 그 사이 누가 시간을 썼으면 바뀐 초는 경계가 아니다
+			if(set_count != ds1302_set_count)
+			{
+				prev = sec;
+				set_count = ds1302_set_count;
+			}
+			else if(sec != prev || (sec & SECONDS_CH))
+			{
+				break;
+			}
+
+			if(!ktime_before(ktime_get(), deadline))
+			{
+				break;
+			}
+		}
+	}
+	anchor = ktime_get();
+
+	halted = ds1302_read_time_date(&t);
+	ds1302_to_rtc_time(&t, &tm);
+	ds1302_update_cache(&tm, anchor, !halted);
+
+	mutex_unlock(&ds1302_lock);
+
+	ds1302_tick_rearm();
+
+	if(halted)
+	{
+		printk(KERN_WARNING "DS1302: oscillator halted or registers invalid, time invalid\n");
+	}
+}
+
+/* 배터리가 없어 클럭이 멈췄거나 레지스터가 날짜가 아닌 경우에만 기본 시간으로 초기화한다 */
+static void ds1302_init_default_time(void)
+{
+	t_ds1302 t;
+
+	mutex_lock(&ds1302_lock);
+	if(ds1302_read_time_date(&t))
+	{
+		t.year = 25;
+		t.month = 12;
+		t.date = 24;
+		t.dayofweek = 4;
+		t.hours = 14;
+		t.minutes = 30;
+		t.seconds = 0;
+
+		ds1302_init_time_date(&t);
+	}
+	mutex_unlock(&ds1302_lock);
 }
 
+static void ds1302_resync_work_fn(struct work_struct *work)
+{
+	ds1302_resync(true);
+	schedule_delayed_work(&ds1302_resync_work, max(resync_sec, 1U) * HZ);
+}
+
+/* 캐시에서 외삽한 현재 시간. GPIO 접근 없음 */
+static bool ds1302_get_time(struct rtc_time *tm)
+{
+	unsigned int seq;
+	time64_t secs;
+	ktime_t anchor;
+	bool valid;
+
+	do
+	{
+		seq = read_seqbegin(&ds1302_seq);
+		secs = cache_secs;
+		anchor = cache_anchor;
+		valid = cache_valid;
+	} while(read_seqretry(&ds1302_seq, seq));
+
+	secs += ktime_divns(ktime_sub(ktime_get(), anchor), NSEC_PER_SEC);
+	rtc_time64_to_tm(secs, tm);
+
+	return valid;
+}
+
+/* 앵커 기준 다음 초 경계 (CLOCK_MONOTONIC) */
+static ktime_t ds1302_next_tick(void)
+{
+	unsigned int seq;
+	ktime_t anchor;
+	s64 elapsed;
+
+	do
+	{
+		seq = read_seqbegin(&ds1302_seq);
+		anchor = cache_anchor;
+	} while(read_seqretry(&ds1302_seq, seq));
+
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), anchor));
+	return ktime_add_ns(anchor, (div64_s64(elapsed, NSEC_PER_SEC) + 1) * NSEC_PER_SEC);
+}
+
+/* RTC 시각이 secs 가 되는 초 경계 (CLOCK_MONOTONIC) */
+static ktime_t ds1302_secs_to_ktime(time64_t secs)
+{
+	unsigned int seq;
+	time64_t base;
+	ktime_t anchor;
+
+	do
+	{
+		seq = read_seqbegin(&ds1302_seq);
+		base = cache_secs;
+		anchor = cache_anchor;
+	} while(read_seqretry(&ds1302_seq, seq));
+
+	return ktime_add_ns(anchor, (secs - base) * NSEC_PER_SEC);
+}
+
+/* ds1302_alarm_lock 을 잡은 상태에서 호출 */
+static void ds1302_alarm_arm(void)
+{
+	struct rtc_time tm;
+	time64_t now, target;
+
+	if(!ds1302_alarm_enabled)
+	{
+		return;
+	}
+
+	/*
+	 * 먼 알람은 최대 하루 뒤에 한 번 깨운다. 일찍 깨어나도 RTC core 가 현재 시간을
+	 * 확인한 뒤 남은 알람을 다시 set_alarm 으로 걸어준다. 지난 알람은 바로 울린다.
+	 */
+	ds1302_get_time(&tm);
+	now = rtc_tm_to_time64(&tm);
+	target = clamp_t(time64_t, ds1302_alarm_time, now, now + 86400);
+
+	hrtimer_start(&ds1302_alarm_timer, ds1302_secs_to_ktime(target), HRTIMER_MODE_ABS_SOFT);
+}
+
+static void ds1302_alarm_rearm(void)
+{
+	mutex_lock(&ds1302_alarm_lock);
+	ds1302_alarm_arm();
+	mutex_unlock(&ds1302_alarm_lock);
+}
+
+static void ds1302_alarm_stop(void)
+{
+	mutex_lock(&ds1302_alarm_lock);
+	ds1302_alarm_enabled = false;
+	hrtimer_cancel(&ds1302_alarm_timer);
+	mutex_unlock(&ds1302_alarm_lock);
+}
+
+static void ds1302_tick_notify(void)
+{
+	struct rtc_time tm;
+	bool valid;
+
+	atomic_long_inc(&ds1302_tick);
+	wake_up_interruptible(&ds1302_wait);
+
+	valid = ds1302_get_time(&tm);
+	sensorhub_publish_time(&tm, valid);
+}
+
+static enum hrtimer_restart ds1302_tick_fn(struct hrtimer *timer)
+{
+	ds1302_tick_notify();
+	hrtimer_set_expires(timer, ds1302_next_tick());
+
+	return HRTIMER_RESTART;
+}
+
+/* 앵커가 바뀌었을 때 틱과 알람의 위상을 새 초 경계에 맞춘다 */
+static void ds1302_tick_rearm(void)
+{
+	mutex_lock(&ds1302_open_lock);
+	if(ds1302_users && !ds1302_dead)
+	{
+		hrtimer_start(&ds1302_tick_timer, ds1302_next_tick(), HRTIMER_MODE_ABS_SOFT);
+	}
+	mutex_unlock(&ds1302_open_lock);
+
+	ds1302_alarm_rearm();
+}
+
+static void ds1302_tick_get(void)
+{
+	mutex_lock(&ds1302_open_lock);
+	if(ds1302_users++ == 0 && !ds1302_dead)
+	{
+		hrtimer_start(&ds1302_tick_timer, ds1302_next_tick(), HRTIMER_MODE_ABS_SOFT);
+	}
+	mutex_unlock(&ds1302_open_lock);
+}
+
+static void ds1302_tick_put(void)
+{
+	mutex_lock(&ds1302_open_lock);
+	if(--ds1302_users == 0)
+	{
+		hrtimer_cancel(&ds1302_tick_timer);
+	}
+	mutex_unlock(&ds1302_open_lock);
+}
+
+/* sensorhub 사용자가 있을 때만 매초 시간을 넣는다 (게시는 틱 콜백, softirq 에서) */
+static int ds1302_hub_event(struct notifier_block *nb, unsigned long event, void *data)
+{
+	if(event == SENSORHUB_ACTIVE)
+	{
+		ds1302_tick_get();
+	}
+	else if(event == SENSORHUB_IDLE)
+	{
+		ds1302_tick_put();
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block ds1302_hub_nb = {
+	.notifier_call = ds1302_hub_event,
+};
+
+/* remove 이후 장치 정리: 틱과 알람을 멈추고 대기 중인 reader 를 깨운다 */
+static void ds1302_kill(void)
+{
+	mutex_lock(&ds1302_lock);
+	mutex_lock(&ds1302_open_lock);
+	ds1302_dead = true;
+	hrtimer_cancel(&ds1302_tick_timer);
+	mutex_unlock(&ds1302_open_lock);
+	mutex_unlock(&ds1302_lock);
+
+	// ds1302_dead 이후에는 alarm_irq_enable 이 -ENODEV 이므로 다시 걸리지 않는다
+	ds1302_alarm_stop();
+
+	wake_up_interruptible(&ds1302_wait);
+}
+
+static int ds1302_set_time(const struct rtc_time *tm)
+{
+	t_ds1302 t;
+
+	rtc_time_to_ds1302(tm, &t);
+
+	mutex_lock(&ds1302_lock);
+	if(ds1302_dead)
+	{
+		mutex_unlock(&ds1302_lock);
+		return -ENODEV;
+	}
+	ds1302_init_time_date(&t);
+	ds1302_update_cache(tm, ktime_get(), true);
+	ds1302_set_count++;
+	mutex_unlock(&ds1302_lock);
+
+	// 시간이 바뀌었으므로 대기 중인 reader 를 바로 깨운다
+	ds1302_tick_notify();
+	ds1302_tick_rearm();
+
+	return 0;
+}
+
+/*
+ * 틱이 지나갔으면 true. 아직이면 O_NONBLOCK 은 -EAGAIN, 아니면 다음 초 경계까지 잔다.
+ * 처음 열었을 때는 바로 읽을 수 있도록 seen_tick 을 한 틱 뒤로 잡아 둔다.
+ */
+static int ds1302_wait_tick(struct file *file)
+{
+	struct ds1302_file *df = file->private_data;
+
+	if(atomic_long_read(&ds1302_tick) == df->seen_tick)
+	{
+		if(file->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+
+		if(wait_event_interruptible(ds1302_wait,
+									atomic_long_read(&ds1302_tick) != df->seen_tick ||
+									READ_ONCE(ds1302_dead)))
+		{
+			return -ERESTARTSYS;
+		}
+	}
+	if(READ_ONCE(ds1302_dead))
+	{
+		return -ENODEV;
+	}
+	df->seen_tick = atomic_long_read(&ds1302_tick);
+
+	return 0;
+}
+
+static int ds1302_open(struct inode *inode, struct file *file)
+{
+	struct ds1302_file *df;
+
+	df = kzalloc(sizeof(*df), GFP_KERNEL);
+	if(!df)	return -ENOMEM;
+
+	df->seen_tick = atomic_long_read(&ds1302_tick) - 1;
+	file->private_data = df;
+
+	ds1302_tick_get();
+
+	return 0;
+}
+
+static int ds1302_release(struct inode *inode, struct file *file)
+{
+	ds1302_tick_put();
+
+	kfree(file->private_data);
+	return 0;
+}
+
+/* 초가 바뀔 때마다 한 번씩 한 줄을 돌려준다 (첫 read 는 즉시) */
 static ssize_t ds1302_read(struct file *file, char __user *buf, size_t len, loff_t *offset)
 {
+	struct rtc_time tm;
 	char time_str[64];
 	int str_len;
+	int ret;
 
-	ds1302_read_time();
-	ds1302_read_date();
+	ret = ds1302_wait_tick(file);
+	if(ret)	return ret;
+
+	if(!ds1302_get_time(&tm))
+	{
+		return -EIO;
+	}
 
 	str_len = snprintf(time_str, sizeof(time_str), "%04d-%02d-%02d %02d:%02d:%02d\n",
-					ds_time.year+2000,
-					ds_time.month,
-					ds_time.date,
-					ds_time.hours,
-					ds_time.minutes,
-					ds_time.seconds);
+					tm.tm_year + 1900,
+					tm.tm_mon + 1,
+					tm.tm_mday,
+					tm.tm_hour,
+					tm.tm_min,
+					tm.tm_sec);
 
 	if(copy_to_user(buf, time_str, str_len))
 	{
@@ -200,6 +816,7 @@ static ssize_t ds1302_read(struct file *file, char __user *buf, size_t len, loff
 static ssize_t ds1302_write(struct file *file, const char __user *buf, size_t len, loff_t *offset)
 {
 	char cmd[32];
+	int ret;
 
 	if(len > sizeof(cmd) - 1)	return -EINVAL;
 	if(copy_from_user(cmd, buf, len))	return -EFAULT;
@@ -208,130 +825,467 @@ static ssize_t ds1302_write(struct file *file, const char __user *buf, size_t le
 
 	if(len >= 12)
 	{
+		struct rtc_time tm = {0};
 		char temp[3];
 		temp[2] = '\0';
 
 		memcpy(temp, cmd, 2);
-		ds_time.year = simple_strtoul(temp, NULL, 10);
+		tm.tm_year = simple_strtoul(temp, NULL, 10) + 100;
 
 		memcpy(temp, cmd+2, 2);
-		ds_time.month = simple_strtoul(temp, NULL, 10);
+		tm.tm_mon = simple_strtoul(temp, NULL, 10) - 1;
 
 		memcpy(temp, cmd+4, 2);
-		ds_time.date = simple_strtoul(temp, NULL, 10);
+		tm.tm_mday = simple_strtoul(temp, NULL, 10);
 
 		memcpy(temp, cmd+6, 2);
-		ds_time.hours = simple_strtoul(temp, NULL, 10);
+		tm.tm_hour = simple_strtoul(temp, NULL, 10);
 
 		memcpy(temp, cmd+8, 2);
-		ds_time.minutes = simple_strtoul(temp, NULL, 10);
+		tm.tm_min = simple_strtoul(temp, NULL, 10);
 
 		memcpy(temp, cmd+10, 2);
-		ds_time.seconds = simple_strtoul(temp, NULL, 10);
+		tm.tm_sec = simple_strtoul(temp, NULL, 10);
 
-		ds_time.dayofweek = 0;
+		if(rtc_valid_tm(&tm))	return -EINVAL;
 
-		printk(KERN_INFO "시간 설정");
-		printk(KERN_INFO "DS1302 : %04d-%02d-%02d %02d:%02d:%02d\n",
-                   ds_time.year+2000, ds_time.month, ds_time.date,
-                   ds_time.hours, ds_time.minutes, ds_time.seconds);
+		// 요일 계산
+		rtc_time64_to_tm(rtc_tm_to_time64(&tm), &tm);
 
-		ds1302_init_time_date();
+		printk(KERN_INFO "시간 설정");
+		printk(KERN_INFO "DS1302 : %ptRs\n", &tm);
 
+		ret = ds1302_set_time(&tm);
+		if(ret)	return ret;
 	}
 	return len;
 }
 
-static void ds1302_timer_callback(struct timer_list *data)
+/*
+ * 바이너리 인터페이스: <linux/rtc.h> 의 RTC_RD_TIME / RTC_SET_TIME 과 struct rtc_time 을
+ * 그대로 사용하므로 문자열 포맷/파싱 없이 구조체 복사만으로 시간을 주고받는다.
+ * DS1302 의 연도 레지스터는 두 자리이므로 2000~2099 년만 허용한다.
+ */
+static long ds1302_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct ds1302_file *df = file->private_data;
+	void __user *uarg = (void __user *)arg;
+	struct rtc_time tm;
+
+	if(READ_ONCE(ds1302_dead))	return -ENODEV;
+
+	switch(cmd)
+	{
+	case RTC_RD_TIME:
+		// 이 파일의 틱을 소비하므로 poll() 후 RTC_RD_TIME 으로 읽어도 된다
+		df->seen_tick = atomic_long_read(&ds1302_tick);
+		if(!ds1302_get_time(&tm))	return -EIO;
+		if(copy_to_user(uarg, &tm, sizeof(tm)))	return -EFAULT;
+		return 0;
+
+	case RTC_SET_TIME:
+		if(copy_from_user(&tm, uarg, sizeof(tm)))	return -EFAULT;
+		if(rtc_valid_tm(&tm) || tm.tm_year < 100 || tm.tm_year > 199)	return -EINVAL;
+
+		// 요일/연중일 계산
+		rtc_time64_to_tm(rtc_tm_to_time64(&tm), &tm);
+		return ds1302_set_time(&tm);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static __poll_t ds1302_poll(struct file *file, poll_table *wait)
 {
-	ds1302_read_time();
-	ds1302_read_date();
+	struct ds1302_file *df = file->private_data;
 
+	poll_wait(file, &ds1302_wait, wait);
 
-	printk(KERN_INFO "DS1302: %04d-%02d-%02d %02d:%02d:%02d\n",
-		   ds_time.year + 2000,
-		   ds_time.month,
-		   ds_time.date,
-		   ds_time.hours,
-		   ds_time.minutes,
-		   ds_time.seconds);
+	if(READ_ONCE(ds1302_dead))
+	{
+		return EPOLLHUP | EPOLLERR;
+	}
 
-	mod_timer(&ds1302_timer, jiffies + msecs_to_jiffies(BLINK_PERIOD_MS));
+	if(atomic_long_read(&ds1302_tick) != df->seen_tick)
+	{
+		return EPOLLIN | EPOLLRDNORM;
+	}
+
+	return 0;
 }
 
 static struct file_operations fops = {
 	.owner = THIS_MODULE,
+	.open = ds1302_open,
+	.release = ds1302_release,
 	.read = ds1302_read,
 	.write = ds1302_write,
+	.poll = ds1302_poll,
+	.unlocked_ioctl = ds1302_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
 };
 
-static int __init ds1302_init(void)
+/* --- RTC class --- */
+
+static int ds1302_rtc_read_time(struct device *dev, struct rtc_time *tm)
+{
+	if(READ_ONCE(ds1302_dead))	return -ENODEV;
+
+	// 클럭이 멈춰 있으면 시간이 유효하지 않다
+	return ds1302_get_time(tm) ? 0 : -EINVAL;
+}
+
+static int ds1302_rtc_set_time(struct device *dev, struct rtc_time *tm)
+{
+	return ds1302_set_time(tm);
+}
+
+/* softirq 에서 실행: 알람 시각의 초 경계 (RTC_UIE_ON 이면 매초 경계) */
+static enum hrtimer_restart ds1302_alarm_fn(struct hrtimer *timer)
+{
+	rtc_update_irq(ds1302_rtc, 1, RTC_AF | RTC_IRQF);
+
+	return HRTIMER_NORESTART;
+}
+
+static int ds1302_rtc_alarm_irq_enable(struct device *dev, unsigned int enabled)
 {
+	struct rtc_time tm;
 	int ret;
-	printk(KERN_INFO "====== ds1302 initializeing ======\n");
-  	ret = alloc_chrdev_region(&device_number, 0, 1, DEVICE_NAME);
-  	if (ret == -1) 
+
+	if(!enabled)
 	{
-    	printk(KERN_ERR "ERROR: alloc_chardev_regin ........\n");
-    	return ret;
+		ds1302_alarm_stop();
+		return 0;
 	}
 
-	cdev_init(&ds1302_cdev, &fops);
-  	if ((ret = cdev_add(&ds1302_cdev, device_number, 1)) == -1)
+	ret = ds1302_rtc_read_time(dev, &tm);
+	if(ret)
 	{
-		printk(KERN_ERR "ERROR: cdev_add  ........\n");
-    	unregister_chrdev_region(device_number, 1);
-   		return ret;
+		return ret;
 	}
 
-	ds1302_class = class_create(THIS_MODULE, DEVICE_NAME);
-	if (IS_ERR(ds1302_class))
+	mutex_lock(&ds1302_alarm_lock);
+	ds1302_alarm_enabled = true;
+	ds1302_alarm_arm();
+	mutex_unlock(&ds1302_alarm_lock);
+
+	return 0;
+}
+
+static int ds1302_rtc_read_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	rtc_time64_to_tm(ds1302_alarm_time, &alrm->time);
+	alrm->enabled = hrtimer_active(&ds1302_alarm_timer);
+
+	return 0;
+}
+
+static int ds1302_rtc_set_alarm(struct device *dev, struct rtc_wkalrm *alrm)
+{
+	ds1302_alarm_time = rtc_tm_to_time64(&alrm->time);
+
+	return ds1302_rtc_alarm_irq_enable(dev, alrm->enabled);
+}
+
+/*
+ * set_alarm 을 제공하므로 RTC core 의 타이머 큐가 알람과 update interrupt
+ * (RTC_UIE_ON) 를 모두 이 소프트웨어 알람 위에서 처리한다.
+ */
+static const struct rtc_class_ops ds1302_rtc_ops = {
+	.read_time = ds1302_rtc_read_time,
+	.set_time = ds1302_rtc_set_time,
+	.read_alarm = ds1302_rtc_read_alarm,
+	.set_alarm = ds1302_rtc_set_alarm,
+	.alarm_irq_enable = ds1302_rtc_alarm_irq_enable,
+};
+
+/* --- NVMEM (31 byte battery-backed RAM) --- */
+
+static int ds1302_nvmem_read(void *priv, unsigned int offset, void *val, size_t bytes)
+{
+	uint8_t ram[RAM_SIZE];
+
+	// burst 는 0 번지부터이므로 필요한 끝까지만 읽고 CE 를 내린다
+	mutex_lock(&ds1302_lock);
+	if(ds1302_dead)
+	{
+		mutex_unlock(&ds1302_lock);
+		return -ENODEV;
+	}
+	ds1302_read_burst(CMD_RAM_BURST, ram, offset + bytes);
+	mutex_unlock(&ds1302_lock);
+
+	memcpy(val, ram + offset, bytes);
+	return 0;
+}
+
+static int ds1302_nvmem_write(void *priv, unsigned int offset, void *val, size_t bytes)
+{
+	uint8_t ram[RAM_SIZE];
+
+	mutex_lock(&ds1302_lock);
+	if(ds1302_dead)
 	{
-    	cdev_del(&ds1302_cdev);
-    	unregister_chrdev_region(device_number, 1);
-    	return PTR_ERR(ds1302_class);
+		mutex_unlock(&ds1302_lock);
+		return -ENODEV;
 	}
-	ds1302_device = device_create(ds1302_class, NULL, device_number, NULL, DEVICE_NAME);
 
-	if (gpio_request(GPIO_CLK, "my_ds1302") ||
-		gpio_request(GPIO_DAT, "my_ds1302") ||
-		gpio_request(GPIO_RST, "my_ds1302")) {
-	printk(KERN_ERR "ERROR: gpio_request  ........\n");
-    return -1;
+	// 앞부분은 기존 값을 그대로 다시 쓴다 (RAM burst 는 일부 바이트만 써도 반영된다)
+	if(offset)
+	{
+		ds1302_read_burst(CMD_RAM_BURST, ram, offset);
 	}
+	memcpy(ram + offset, val, bytes);
+
+	ds1302_write_byte(ADDR_CONTROL, 0x00);
+	ds1302_write_burst(CMD_RAM_BURST, ram, offset + bytes);
+	ds1302_write_byte(ADDR_CONTROL, CONTROL_WP);
 
-	gpio_direction_output(GPIO_CLK, 0);
-	gpio_direction_output(GPIO_DAT, 0);
-	gpio_direction_output(GPIO_RST, 0);
+	mutex_unlock(&ds1302_lock);
 
-	ds_time.year = 25;
-    ds_time.month = 12;
-    ds_time.date = 24;
-    ds_time.dayofweek = 3;
-    ds_time.hours = 14;
-    ds_time.minutes = 30;
-    ds_time.seconds = 0;
+	return 0;
+}
 
-	ds1302_init_time_date();
+/* --- debugfs: /sys/kernel/debug/ds1302/bench --- */
 
-	timer_setup(&ds1302_timer, ds1302_timer_callback, 0);
-	mod_timer(&ds1302_timer, jiffies + msecs_to_jiffies(BLINK_PERIOD_MS));
+#define BENCH_ITER	100
+
+struct ds1302_bench_stat {
+	u64 min;
+	u64 max;
+	u64 total;
+};
+
+static void ds1302_bench_add(struct ds1302_bench_stat *st, u64 ns)
+{
+	st->min = min(st->min, ns);
+	st->max = max(st->max, ns);
+	st->total += ns;
+}
+
+static void ds1302_bench_print(struct seq_file *s, const char *name, const struct ds1302_bench_stat *st)
+{
+	seq_printf(s, "%-22s min %llu  avg %llu  max %llu ns\n",
+			   name, st->min, div_u64(st->total, BENCH_ITER), st->max);
+}
+
+/* 읽을 때마다 clock burst 와 초 레지스터 단일 읽기를 BENCH_ITER 번씩 재서 보여준다 */
+static int ds1302_bench_show(struct seq_file *s, void *unused)
+{
+	struct ds1302_bench_stat burst = { .min = U64_MAX };
+	struct ds1302_bench_stat single = { .min = U64_MAX };
+	uint8_t regs[CLOCK_BURST_LEN];
+	u64 t0;
+
+	for(int i = 0; i < BENCH_ITER; i++)
+	{
+		mutex_lock(&ds1302_lock);
+
+		t0 = ktime_get_ns();
+		ds1302_read_burst(CMD_CLOCK_BURST, regs, CLOCK_BURST_LEN);
+		ds1302_bench_add(&burst, ktime_get_ns() - t0);
+
+		t0 = ktime_get_ns();
+		ds1302_read_byte(ADDR_SECONDS);
+		ds1302_bench_add(&single, ktime_get_ns() - t0);
+
+		mutex_unlock(&ds1302_lock);
+		cond_resched();
+	}
+
+	seq_printf(s, "timing: %s, iterations: %d\n", fast_timing ? "5V" : "2V", BENCH_ITER);
+	ds1302_bench_print(s, "clock burst (8 byte)", &burst);
+	ds1302_bench_print(s, "single byte read", &single);
 
-	printk(KERN_INFO "ds1302 driver init success ........\n");
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(ds1302_bench);
 
-static void __exit ds1302_exit(void)
+static int ds1302_probe(struct platform_device *pdev)
 {
-	del_timer(&ds1302_timer);
+	struct device *dev = &pdev->dev;
+	struct nvmem_config nvmem_cfg = {
+		.name = "ds1302_ram",
+		.id = NVMEM_DEVID_NONE,
+		.dev = dev,
+		.owner = THIS_MODULE,
+		.size = RAM_SIZE,
+		.word_size = 1,
+		.stride = 1,
+		.reg_read = ds1302_nvmem_read,
+		.reg_write = ds1302_nvmem_write,
+	};
+	struct nvmem_device *nvmem;
+	int ret;
+
+	ds1302_bus = devm_gpiod_get_array(dev, "bus", GPIOD_OUT_LOW);
+	if (IS_ERR(ds1302_bus))
+		return dev_err_probe(dev, PTR_ERR(ds1302_bus), "ERROR: bus-gpios\n");
+	if (ds1302_bus->ndescs != 2)
+		return dev_err_probe(dev, -EINVAL, "ERROR: bus-gpios needs <CLK>, <IO>\n");
+
+	ds1302_ce = devm_gpiod_get(dev, "ce", GPIOD_OUT_LOW);
+	if (IS_ERR(ds1302_ce))
+		return dev_err_probe(dev, PTR_ERR(ds1302_ce), "ERROR: ce-gpios\n");
+
+	// 다시 bind 된 경우: 앞선 unbind 뒤에도 열려 있던 파일의 틱은 아래 resync 가 다시 건다
+	ds1302_dead = false;
+
+	ds1302_init_default_time();
+
+	// 우선 바로 캐시를 채우고, 초 경계 동기화는 워크큐에서 한다
+	ds1302_resync(false);
+	INIT_DELAYED_WORK(&ds1302_resync_work, ds1302_resync_work_fn);
+	schedule_delayed_work(&ds1302_resync_work, 0);
+
+	// /dev/sensorhub 를 읽는 사용자가 있는 동안 매초 시간을 넣는다
+	ret = sensorhub_register_notifier(&ds1302_hub_nb);
+	if (ret)
+		goto err_resync;
+
+	cdev_init(&ds1302_cdev, &fops);
+	ret = cdev_add(&ds1302_cdev, device_number, 1);
+	if (ret)
+	{
+		dev_err(dev, "ERROR: cdev_add  ........\n");
+		goto err_work;
+	}
+
+	ds1302_device = device_create(ds1302_class, dev, device_number, NULL, DEVICE_NAME);
+	if (IS_ERR(ds1302_device))
+	{
+		ret = PTR_ERR(ds1302_device);
+		goto err_cdev;
+	}
+
+	// /dev/rtcN 등록 (hwclock, hctosys)
+	ds1302_rtc = devm_rtc_allocate_device(dev);
+	if (IS_ERR(ds1302_rtc))
+	{
+		ret = PTR_ERR(ds1302_rtc);
+		goto err_device;
+	}
+
+	ds1302_rtc->ops = &ds1302_rtc_ops;
+	ds1302_rtc->range_min = RTC_TIMESTAMP_BEGIN_2000;
+	ds1302_rtc->range_max = RTC_TIMESTAMP_END_2099;
+
+	ret = devm_rtc_register_device(ds1302_rtc);
+	if (ret)
+		goto err_device;
+
+	// /sys/bus/nvmem/devices/ds1302_ram/nvmem
+	nvmem = devm_nvmem_register(dev, &nvmem_cfg);
+	if (IS_ERR(nvmem))
+	{
+		ret = PTR_ERR(nvmem);
+		goto err_device;
+	}
 
-	gpio_free(GPIO_CLK);
-	gpio_free(GPIO_DAT);
-	gpio_free(GPIO_RST);
+	ds1302_debugfs = debugfs_create_dir(DEVICE_NAME, NULL);
+	debugfs_create_file("bench", 0444, ds1302_debugfs, NULL, &ds1302_bench_fops);
 
+	dev_info(dev, "ds1302 ready (%s timing)\n", fast_timing ? "5V" : "2V");
+	return 0;
+
+err_device:
 	device_destroy(ds1302_class, device_number);
-	class_destroy(ds1302_class);
+err_cdev:
 	cdev_del(&ds1302_cdev);
+err_work:
+	sensorhub_unregister_notifier(&ds1302_hub_nb);
+err_resync:
+	cancel_delayed_work_sync(&ds1302_resync_work);
+	ds1302_kill();
+	return ret;
+}
+
+static int ds1302_remove(struct platform_device *pdev)
+{
+	debugfs_remove_recursive(ds1302_debugfs);
+
+	device_destroy(ds1302_class, device_number);
+	cdev_del(&ds1302_cdev);
+
+	/*
+	 * 열린 파일이 남아 있으면 ds1302_users 는 0 이 되지 않으므로 틱은 사용자 수와
+	 * 상관없이 멈춘다. 이후 GPIO 는 devm 이 해제하므로 모든 경로가 ds1302_dead 를 본다.
+	 */
+	ds1302_kill();
+	cancel_delayed_work_sync(&ds1302_resync_work);
+	// rtc/nvmem 은 remove 뒤 devm 으로 해제되지만 알람은 ds1302_kill() 에서 멈췄다
+	sensorhub_unregister_notifier(&ds1302_hub_nb);
+
+	return 0;
+}
+
+static const struct of_device_id ds1302_dt_ids[] = {
+	{ .compatible = "smartclock,ds1302" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, ds1302_dt_ids);
+
+static struct platform_driver ds1302_driver = {
+	.driver = {
+		.name = "ds1302_rtc",
+		.of_match_table = ds1302_dt_ids,
+	},
+	.probe = ds1302_probe,
+	.remove = ds1302_remove,
+};
+
+static int __init ds1302_init(void)
+{
+	int ret;
+	printk(KERN_INFO "====== ds1302 initializeing ======\n");
+
+	// softirq 에서 실행: 콜백이 캐시를 읽고 sensorhub 에 게시한다
+	hrtimer_init(&ds1302_tick_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+	ds1302_tick_timer.function = ds1302_tick_fn;
+	hrtimer_init(&ds1302_alarm_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS_SOFT);
+	ds1302_alarm_timer.function = ds1302_alarm_fn;
+
+	ret = alloc_chrdev_region(&device_number, 0, 1, DEVICE_NAME);
+	if (ret < 0)
+	{
+		printk(KERN_ERR "ERROR: alloc_chardev_regin ........\n");
+		return ret;
+	}
+
+	ds1302_class = class_create(THIS_MODULE, DEVICE_NAME);
+	if (IS_ERR(ds1302_class))
+	{
+		ret = PTR_ERR(ds1302_class);
+		goto err_region;
+	}
+
+	/*
+	 * GPIO, cdev, 타이머는 모두 probe 에서 잡고 probe 의 에러 경로가 되돌린다.
+	 * 여기서는 타이머를 걸지 않으므로 등록이 실패해도 남는 것은 아래 두 가지뿐이다.
+	 */
+	ret = platform_driver_register(&ds1302_driver);
+	if (ret)
+	{
+		printk(KERN_ERR "ERROR: platform_driver_register ........\n");
+		goto err_class;
+	}
+
+	printk(KERN_INFO "ds1302 driver init success ........\n");
+	return 0;
+
+err_class:
+	class_destroy(ds1302_class);
+err_region:
+	unregister_chrdev_region(device_number, 1);
+	return ret;
+}
+
+static void __exit ds1302_exit(void)
+{
+	platform_driver_unregister(&ds1302_driver);
+	class_destroy(ds1302_class);
 	unregister_chrdev_region(device_number, 1);
 
 	printk(KERN_INFO "ds1302_driver_exit");
@@ -0,0 +1,65 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ds1302
+
+#if !defined(_DS1302_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _DS1302_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * 3-wire 트랜잭션 tracepoint (/sys/kernel/tracing/events/ds1302/)
+ * CE 를 올린 순간부터 내린 순간까지 한 번을 기록한다.
+ *   cmd : 명령 바이트 (읽기는 +1 된 값), len : 데이터 바이트 수,
+ *   data: 첫 데이터 바이트, ns : CE 구간 길이
+ */
+DECLARE_EVENT_CLASS(ds1302_xfer,
+
+	TP_PROTO(u8 cmd, int len, u8 data, s64 ns),
+
+	TP_ARGS(cmd, len, data, ns),
+
+	TP_STRUCT__entry(
+		__field(u8, cmd)
+		__field(int, len)
+		__field(u8, data)
+		__field(s64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->cmd = cmd;
+		__entry->len = len;
+		__entry->data = data;
+		__entry->ns = ns;
+	),
+
+	TP_printk("cmd=0x%02x len=%d data=0x%02x ns=%lld",
+			  __entry->cmd, __entry->len, __entry->data, __entry->ns)
+);
+
+DEFINE_EVENT(ds1302_xfer, ds1302_read_byte,
+	TP_PROTO(u8 cmd, int len, u8 data, s64 ns),
+	TP_ARGS(cmd, len, data, ns)
+);
+
+DEFINE_EVENT(ds1302_xfer, ds1302_write_byte,
+	TP_PROTO(u8 cmd, int len, u8 data, s64 ns),
+	TP_ARGS(cmd, len, data, ns)
+);
+
+DEFINE_EVENT(ds1302_xfer, ds1302_read_burst,
+	TP_PROTO(u8 cmd, int len, u8 data, s64 ns),
+	TP_ARGS(cmd, len, data, ns)
+);
+
+DEFINE_EVENT(ds1302_xfer, ds1302_write_burst,
+	TP_PROTO(u8 cmd, int len, u8 data, s64 ns),
+	TP_ARGS(cmd, len, data, ns)
+);
+
+#endif /* _DS1302_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE ds1302_trace
+#include <trace/define_trace.h>
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "sensorlog.h"
+
+/*
+ * 온습도 로그 읽기 도구
+ *
+ *   logread <file> [from [to]]
+ *
+ * from/to 는 unix time(초) 또는 "YYYY-MM-DD[ HH:MM[:SS]]" (로컬 시간).
+ * 파일을 읽기 전용으로 mmap 하고 구간(RTC 를 뒤로 맞출 때마다 새로 시작)마다 시간 순인
+ * 링에서 이진 탐색으로 시작 위치를 찾으므로 몇 달치 로그에서도 필요한 부분만 읽는다.
+ * 구간은 쓴 순서대로 보여준다.
+ */
+
+const sensorlog_header_t* hdr;
+const sensorlog_record_t* rec;
+
+const sensorlog_record_t* record_at(uint32_t i) {
+    return &rec[sensorlog_slot(hdr, i)];
+}
+
+int64_t parse_time(const char* arg) {
+    struct tm tm = {0};
+    int n;
+    
+    n = sscanf(arg, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (n >= 3) {
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        return mktime(&tm);
+    }
+    return strtoll(arg, NULL, 10);
+}
+
+// 구간 [lo, used) 에서 구간 순서가 seg 보다 큰 첫 레코드 (없으면 used)
+uint32_t segment_end(uint32_t lo, uint16_t seg) {
+    uint32_t hi = sensorlog_used(hdr);
+    
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (sensorlog_seg_order(record_at(mid), record_at(0)) <= seg) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// [lo, hi) (한 구간) 에서 time >= t 인 첫 레코드 (없으면 hi)
+uint32_t lower_bound(uint32_t lo, uint32_t hi, int64_t t) {
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (record_at(mid)->time < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int main(int argc, char *argv[])
+{
+    struct stat st;
+    void* map;
+    int64_t from = INT64_MIN, to = INT64_MAX;
+    uint32_t used, start, end, i, shown = 0, segments = 0;
+    int fd;
+    
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file> [from [to]]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2) from = parse_time(argv[2]);
+    if (argc > 3) to = parse_time(argv[3]);
+    
+    fd = open(argv[1], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    hdr = map;
+    rec = (const sensorlog_record_t*)((const char*)map + SENSORLOG_DATA_OFFSET);
+    
+    if (st.st_size < SENSORLOG_DATA_OFFSET || memcmp(hdr->magic, SENSORLOG_MAGIC, 4) != 0 ||
+        hdr->version != SENSORLOG_VERSION || hdr->record_size != sizeof(sensorlog_record_t) ||
+        hdr->capacity == 0 || (uint64_t)st.st_size < sensorlog_file_size(hdr->capacity)) {
+        fprintf(stderr, "%s: not a sensor log\n", argv[1]);
+        return 1;
+    }
+    
+    used = sensorlog_used(hdr);
+    for (start = 0; start < used; start = end) {
+        end = segment_end(start, sensorlog_seg_order(record_at(start), record_at(0)));
+        segments++;
+        
+        i = lower_bound(start, end, from);
+        if (i < end && record_at(i)->time <= to && shown > 0) {
+            printf("--- clock set back ---\n");
+        }
+        
+        for (; i < end; i++) {
+            const sensorlog_record_t* r = record_at(i);
+            time_t t = r->time;
+            char when[32];
+            
+            if (r->time > to) {
+                break;
+            }
+            
+            strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&t));
+            if (r->flags & SENSORLOG_F_READ_ERROR) {
+                printf("%s  --C  --%%  %s\n", when, "read-error");
+            } else {
+                printf("%s  %dC  %u%%%s\n", when, r->temp, r->humi,
+                       (r->flags & SENSORLOG_F_TIME_VALID) ? "" : "  time-invalid");
+            }
+            shown++;
+        }
+    }
+    
+    fprintf(stderr, "%u of %u records in %u segment(s) (capacity %u)\n",
+            shown, used, segments, hdr->capacity);
+    
+    munmap(map, st.st_size);
+    close(fd);
+    return 0;
+}
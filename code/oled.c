@@ -9,23 +9,29 @@
 #include <linux/slab.h>
 #include "font.h"
 
+#define CREATE_TRACE_POINTS
+#include "oled_trace.h"
+
 struct ssd1306_data {
     struct i2c_client *client;
     struct gpio_desc *reset_gpio;
     dev_t dev_num;
     struct cdev cdev;
     struct class *class;
+    unsigned int i2c_bytes;     // 이번 write() 에서 보낸 I2C 바이트 (tracepoint 용)
 };
 
 /* --- I2C 하드웨어 제어 --- */
 
 static int ssd1306_write_cmd(struct ssd1306_data *data, u8 cmd) {
     u8 buf[2] = {0x00, cmd};
+    data->i2c_bytes += 2;
     return i2c_master_send(data->client, (char *)buf, 2);
 }
 
 static int ssd1306_write_data(struct ssd1306_data *data, u8 val) {
     u8 buf[2] = {0x40, val};
+    data->i2c_bytes += 2;
     return i2c_master_send(data->client, (char *)buf, 2);
 }
 
@@ -43,6 +49,8 @@ static void ssd1306_clear(struct ssd1306_data *data) {
     }
 }
 static void ssd1306_write_string(struct ssd1306_data *data, const char *str, u8 page, u8 col) {
+    unsigned int start = data->i2c_bytes;
+
     ssd1306_set_pos(data, page, col);
     while (*str) {
         u8 c = (u8)*str++;
@@ -53,6 +61,27 @@ static void ssd1306_write_string(struct ssd1306_data *data, const char *str, u8
         }
         ssd1306_write_data(data, 0x00); // 글자 간 간격(1픽셀)
     }
+    trace_oled_flush(page, col, data->i2c_bytes - start);
+}
+
+/* 폭 width 픽셀 영역에 글자를 쓰고 남는 칸은 지운다 (전체 CLEAR 없이 한 영역만 갱신) */
+static void ssd1306_write_field(struct ssd1306_data *data, const char *str,
+                                u8 page, u8 col, u8 width) {
+    unsigned int start = data->i2c_bytes;
+    int used = 0;
+
+    ssd1306_set_pos(data, page, col);
+    while (*str && used + 6 <= width) {
+        u8 c = (u8)*str++;
+        int i;
+        for (i = 0; i < 5; i++) {
+            ssd1306_write_data(data, ssd1306_font[c][i]);
+        }
+        ssd1306_write_data(data, 0x00);
+        used += 6;
+    }
+    for (; used < width; used++) ssd1306_write_data(data, 0x00);
+    trace_oled_flush(page, col, data->i2c_bytes - start);
 }
 
 /* --- 파일 오퍼레이션 --- */
@@ -62,9 +91,8 @@ static int oled_open(struct inode *inode, struct file *file) {
     return 0;
 }
 
-static ssize_t oled_write(struct file *file, const char __user *buf, 
-                          size_t count, loff_t *ppos) {
-    struct ssd1306_data *data = file->private_data;
+/* 명령 해석과 I2C 전송. oled_write() 가 tracepoint 로 감싼다 */
+static ssize_t oled_do_write(struct ssd1306_data *data, const char __user *buf, size_t count) {
     char kbuf[256];
     size_t len = min(count, (size_t)255);
 
@@ -77,6 +105,25 @@ static ssize_t oled_write(struct file *file, const char __user *buf,
         return count;
     }
 
+    // 부분 갱신: 한 줄에 영역 하나 "AT:<page>,<col>,<width>:<text>" (col/width 는 픽셀)
+    if (strncmp(kbuf, "AT:", 3) == 0) {
+        char *ptr = kbuf;
+        char *line;
+
+        while ((line = strsep(&ptr, "\n")) != NULL) {
+            unsigned int page, col, width;
+            int n = 0;
+
+            if (sscanf(line, "AT:%u,%u,%u:%n", &page, &col, &width, &n) != 3 || n == 0)
+                continue;
+            if (page >= 8 || col >= 128)
+                continue;
+
+            ssd1306_write_field(data, line + n, page, col, min(width, 128 - col));
+        }
+        return count;
+    }
+
     // 특수 포맷: "DATE:2025-12-28\nTIME:14:30:25\nTEMP:25\nHUMI:60"
     if (strncmp(kbuf, "DATE:", 5) == 0) {
         char date[16] = {0};
@@ -168,6 +215,20 @@ static ssize_t oled_write(struct file *file, const char __user *buf,
 
     return count;
 }
+
+static ssize_t oled_write(struct file *file, const char __user *buf,
+                          size_t count, loff_t *ppos) {
+    struct ssd1306_data *data = file->private_data;
+    ssize_t ret;
+
+    trace_oled_write_begin(count);
+    data->i2c_bytes = 0;
+
+    ret = oled_do_write(data, buf, count);
+
+    trace_oled_write_end(count, data->i2c_bytes);
+    return ret;
+}
 static struct file_operations oled_fops = {
     .owner = THIS_MODULE,
     .open = oled_open,
@@ -0,0 +1,78 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM oled
+
+#if !defined(_OLED_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _OLED_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * OLED write() tracepoint (/sys/kernel/tracing/events/oled/)
+ *   oled_write_begin : write() 진입. count = 사용자 버퍼 크기
+ *   oled_flush       : 영역 하나를 I2C 로 내보냄 (page/col 위치, 보낸 I2C 바이트)
+ *   oled_write_end   : write() 끝. i2c_bytes = 이번 write() 에서 보낸 전체 I2C 바이트
+ */
+TRACE_EVENT(oled_write_begin,
+
+	TP_PROTO(size_t count),
+
+	TP_ARGS(count),
+
+	TP_STRUCT__entry(
+		__field(size_t, count)
+	),
+
+	TP_fast_assign(
+		__entry->count = count;
+	),
+
+	TP_printk("count=%zu", __entry->count)
+);
+
+TRACE_EVENT(oled_flush,
+
+	TP_PROTO(u8 page, u8 col, unsigned int bytes),
+
+	TP_ARGS(page, col, bytes),
+
+	TP_STRUCT__entry(
+		__field(u8, page)
+		__field(u8, col)
+		__field(unsigned int, bytes)
+	),
+
+	TP_fast_assign(
+		__entry->page = page;
+		__entry->col = col;
+		__entry->bytes = bytes;
+	),
+
+	TP_printk("page=%u col=%u bytes=%u", __entry->page, __entry->col, __entry->bytes)
+);
+
+TRACE_EVENT(oled_write_end,
+
+	TP_PROTO(size_t count, unsigned int i2c_bytes),
+
+	TP_ARGS(count, i2c_bytes),
+
+	TP_STRUCT__entry(
+		__field(size_t, count)
+		__field(unsigned int, i2c_bytes)
+	),
+
+	TP_fast_assign(
+		__entry->count = count;
+		__entry->i2c_bytes = i2c_bytes;
+	),
+
+	TP_printk("count=%zu i2c_bytes=%u", __entry->count, __entry->i2c_bytes)
+);
+
+#endif /* _OLED_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE oled_trace
+#include <trace/define_trace.h>
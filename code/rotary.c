@@ -2,218 +2,920 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/fs.h>
-#include <linux/gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/interrupt.h>
 #include <linux/cdev.h>
 #include <linux/uaccess.h>
 #include <linux/device.h>
+#include <linux/platform_device.h>
+#include <linux/of.h>
+#include <linux/idr.h>
+#include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
-#include <linux/jiffies.h>
-#include <linux/delay.h> 
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include <linux/hrtimer.h>
+#include <linux/workqueue.h>
+
+#include "sensorhub.h"
+
+#define CREATE_TRACE_POINTS
+#include "rotary_trace.h"
 
 #define DEVICE_NAME		"rotary"
 
-#define S1_GPIO		23
-#define S2_GPIO		24
-#define SW_GPIO		25
+// 한 모듈이 관리할 수 있는 엔코더 수 (/dev/rotary0 ~ /dev/rotary7)
+#define ROTARY_MAX_DEVICES	8
 
-#define DEBOUNCE_MS		20
 #define EVENT_BUF_SIZE	10
 
+// 속도 추정: 이 간격보다 오래 멈추면 속도를 0부터 다시 계산
+#define VELOCITY_RESET_MS	500
+
+enum rotary_event_type {
+	ROTARY_EV_CW,
+	ROTARY_EV_CCW,
+	ROTARY_EV_CLICK,
+	ROTARY_EV_DELTA,
+	ROTARY_EV_LONG,
+	ROTARY_EV_DOUBLE,
+	ROTARY_EV_HOLD_CW,
+	ROTARY_EV_HOLD_CCW,
+	ROTARY_EV_HOLD_DELTA,
+};
+
+static const char * const event_names[] = {
+	[ROTARY_EV_CW]		= "CW",
+	[ROTARY_EV_CCW]		= "CCW",
+	[ROTARY_EV_CLICK]	= "CLICK",
+	[ROTARY_EV_DELTA]	= "DELTA",
+	[ROTARY_EV_LONG]	= "LONG",
+	[ROTARY_EV_DOUBLE]	= "DOUBLE",
+	[ROTARY_EV_HOLD_CW]	= "HOLD_CW",
+	[ROTARY_EV_HOLD_CCW]	= "HOLD_CCW",
+	[ROTARY_EV_HOLD_DELTA]	= "HOLD_DELTA",
+};
+
+struct rotary_event {
+	enum rotary_event_type type;
+	int delta;				// DELTA: 누적된 (가속 적용) 스텝
+	unsigned int rate;		// DELTA: 추정 속도 (detents/s)
+	ktime_t ts;				// 에지 시각 (CLOCK_MONOTONIC, ns)
+};
+
+/*
+ * 디바운스는 jiffies 대신 ktime 으로 비교하므로 HZ 와 무관하게 us 단위로 동작한다.
+ * 에지 후 settle_us 뒤에 hrtimer 에서 핀 상태를 다시 읽어 유효한 입력인지 판정한다.
+ * I2C 확장기나 gpio-sim 처럼 잠들 수 있는 GPIO 면 (can_sleep) hrtimer 는 work 만 걸고
+ * 실제 샘플링은 프로세스 문맥에서 _cansleep 접근자로 한다.
+ * 아래 모듈 파라미터는 모든 엔코더에 공통으로 적용된다.
+ */
+static unsigned int debounce_us = 20000;
+module_param(debounce_us, uint, 0644);
+MODULE_PARM_DESC(debounce_us, "Rotation debounce window in microseconds");
+
+static unsigned int button_debounce_us = 5000;
+module_param(button_debounce_us, uint, 0644);
+MODULE_PARM_DESC(button_debounce_us, "Quiet time the switch must hold before a press/release is accepted, in microseconds");
+
+static unsigned int settle_us = 500;
+module_param(settle_us, uint, 0644);
+MODULE_PARM_DESC(settle_us, "Delay before sampling the pins after an edge, in microseconds");
+
+/*
+ * accumulate=1 이면 회전마다 CW/CCW 를 보내지 않고, read() 시점까지 모인
+ * 스텝을 "DELTA +12 40 <ts>" (스텝, detents/s, ns) 한 줄로 보고한다.
+ * accel_div > 0 이면 detent 하나가 1 + rate / accel_div 스텝으로 커진다.
+ */
+static bool accumulate;
+module_param(accumulate, bool, 0644);
+MODULE_PARM_DESC(accumulate, "Report accumulated DELTA events instead of CW/CCW");
+
+static unsigned int accel_div;
+module_param(accel_div, uint, 0644);
+MODULE_PARM_DESC(accel_div, "Acceleration divisor in detents/s (0 = no acceleration)");
+
+/*
+ * 제스처 인식 (sysfs: /sys/class/rotary/rotaryN/{long_press_ms,double_click_ms})
+ *  - LONG       : long_press_ms 이상 누르고 있으면 누른 상태에서 즉시 1회
+ *  - CLICK      : 떼는 순간 (double_click_ms > 0 이면 그 시간 동안 두 번째 클릭을 기다린 뒤)
+ *  - DOUBLE     : double_click_ms 안에 두 번 클릭
+ *  - HOLD_CW/CCW/DELTA : 버튼을 누른 채 회전 (이 경우 떼어도 CLICK 은 보내지 않는다)
+ * double_click_ms = 0 이면 더블 클릭 인식을 끄고 CLICK 을 지연 없이 보낸다.
+ */
+#define DEFAULT_LONG_PRESS_MS	800
+
+/*
+ * 엔코더 한 개의 상태. 디바이스 트리 노드 하나당 하나씩 생성된다.
+ * 수명은 chardev 의 참조 카운트를 따른다: 열린 파일이 cdev 를 통해 chardev 를 잡고 있으므로
+ * unbind 뒤에도 마지막 close 까지 남아 있다가 rotary_dev_release() 에서 해제된다.
+ */
+struct rotary_dev {
+	struct device *dev;
+	int id;
+
+	struct gpio_desc *s1_gpio;
+	struct gpio_desc *s2_gpio;
+	struct gpio_desc *sw_gpio;
+	int irq_s1;
+	int irq_sw;
+
+	struct cdev cdev;
+	struct device chardev;
+
+	ktime_t last_interrupt_time_s1;
+	ktime_t last_interrupt_time_sw;
+
+	struct hrtimer s1_settle_timer;
+	struct hrtimer sw_settle_timer;
+	struct hrtimer long_press_timer;
+	struct hrtimer double_click_timer;
+
+	// can_sleep 이면 settle 샘플링을 이 work 에서 한다
+	bool can_sleep;
+	struct work_struct s1_settle_work;
+	struct work_struct sw_settle_work;
+
+	unsigned int long_press_ms;
+	unsigned int double_click_ms;
+
+	spinlock_t lock;
+
+	struct rotary_event event_buffer[EVENT_BUF_SIZE];
+	int event_head;
+	int event_tail;
+
+	// 버튼 상태 (lock 보호)
+	bool button_down;
+	bool button_turned;
+	bool long_fired;
+	bool click_pending;
+	ktime_t press_time;
+	ktime_t click_time;
+
+	// 누적 모드 상태 (lock 보호)
+	int acc_delta;
+	unsigned int acc_rate;
+	int acc_dir;
+	bool acc_held;
+	ktime_t acc_last_detent;
+	ktime_t acc_ts;
+
+	// 누적 위치 (lock 보호). 인스턴스 0 은 /dev/sensorhub 에 게시한다
+	int position;
+
+	// remove 된 뒤 (열린 파일의 read/poll 은 -ENODEV / EPOLLHUP)
+	bool dead;
+
+	wait_queue_head_t wait_queue;
+	struct fasync_struct *async_queue;
+};
+
 static dev_t device_number;
-static struct cdev rotary_cdev;
 static struct class *rotary_class;
+static DEFINE_IDA(rotary_ida);
 
-static int interrupt_num_s1;
-static int interrupt_num_sw;
+static bool rotary_event_pending(struct rotary_dev *rd)
+{
+	return rd->event_head != rd->event_tail || rd->acc_delta != 0;
+}
 
-static unsigned long last_interrupt_time_s1 = 0;
-static unsigned long last_interrupt_time_sw = 0;
+static bool rotary_dead(struct rotary_dev *rd)
+{
+	return READ_ONCE(rd->dead);
+}
 
-static char event_buffer[EVENT_BUF_SIZE][16];
-static int event_head = 0;
-static int event_tail = 0;
+static void rotary_notify(struct rotary_dev *rd)
+{
+	wake_up_interruptible(&rd->wait_queue);
+	kill_fasync(&rd->async_queue, SIGIO, POLL_IN);
+}
 
-static int data_ready = 0;
-static DECLARE_WAIT_QUEUE_HEAD(rotary_wait_queue);
+/* rd->lock 을 잡은 상태에서 호출 */
+static bool push_event(struct rotary_dev *rd, const struct rotary_event *ev)
+{
+	int next = (rd->event_head + 1) % EVENT_BUF_SIZE;
+
+	if(next == rd->event_tail)
+	{
+		dev_warn(rd->dev, "Buffer Full\n");
+		return false;
+	}
+
+	rd->event_buffer[rd->event_head] = *ev;
+	rd->event_head = next;
+
+	trace_rotary_enqueue(rd->id, event_names[ev->type], ev->delta, ev->ts,
+						 (rd->event_head - rd->event_tail + EVENT_BUF_SIZE) % EVENT_BUF_SIZE);
+
+	return true;
+}
+
+/* rd->lock 을 잡은 상태에서 호출: 남은 누적값을 순서 유지를 위해 큐에 넣는다 */
+static void flush_delta(struct rotary_dev *rd)
+{
+	struct rotary_event ev = {
+		.type = rd->acc_held ? ROTARY_EV_HOLD_DELTA : ROTARY_EV_DELTA,
+		.delta = rd->acc_delta,
+		.rate = rd->acc_rate,
+		.ts = rd->acc_ts,
+	};
+
+	if(rd->acc_delta != 0 && push_event(rd, &ev))
+	{
+		rd->acc_delta = 0;
+	}
+}
+
+/* rd->lock 을 잡은 상태에서 호출 */
+static void queue_event(struct rotary_dev *rd, enum rotary_event_type type, ktime_t ts)
+{
+	struct rotary_event ev = { .type = type, .ts = ts };
+
+	flush_delta(rd);
+	push_event(rd, &ev);
+}
 
-static void add_event(const char *event)
+/* rd->lock 을 잡은 상태에서 호출. 가속을 적용한 스텝을 돌려준다 */
+static int add_detent(struct rotary_dev *rd, int dir, ktime_t now, bool held)
 {
-	int next = (event_head + 1) % EVENT_BUF_SIZE;
+	s64 interval_ns;
+	int step = 1;
 
-	if(next == event_tail)
+	// 누름 여부가 바뀌면 DELTA 와 HOLD_DELTA 가 섞이지 않도록 먼저 내보낸다
+	if(held != rd->acc_held)
 	{
-		printk(KERN_WARNING "Buffer Full\n");
-		return;
+		flush_delta(rd);
+		rd->acc_held = held;
 	}
 
-	strncpy(event_buffer[event_head], event, 15);
-	event_buffer[event_head][15] = '\0';
-	event_head = next;
+	interval_ns = ktime_to_ns(ktime_sub(now, rd->acc_last_detent));
+	if(dir != rd->acc_dir || interval_ns <= 0 ||
+	   interval_ns > (s64)VELOCITY_RESET_MS * NSEC_PER_MSEC)
+	{
+		rd->acc_rate = 0;
+	}
+	else
+	{
+		unsigned int inst = div64_s64(NSEC_PER_SEC, interval_ns);
+
+		// 지수 이동 평균 (1/4 가중)
+		rd->acc_rate = rd->acc_rate ? (rd->acc_rate * 3 + inst) / 4 : inst;
+	}
+	rd->acc_dir = dir;
+	rd->acc_last_detent = now;
+
+	if(accel_div)
+	{
+		step += rd->acc_rate / accel_div;
+	}
+	rd->acc_delta += dir * step;
+	rd->acc_ts = now;
 
-	data_ready = 1;
-	wake_up_interruptible(&rotary_wait_queue);
+	return dir * step;
+}
+
+static bool debounced(ktime_t now, ktime_t *last, unsigned int window_us)
+{
+	if(ktime_us_delta(now, *last) < window_us)
+	{
+		return false;
+	}
+	*last = now;
+	return true;
 }
 
 static irqreturn_t rotary_handler(int irq, void *dev_id)
 {
-		unsigned long current_time = jiffies;
-		unsigned long debounce_jiffies = msecs_to_jiffies(DEBOUNCE_MS);
+	struct rotary_dev *rd = dev_id;
+
+	trace_rotary_irq(rd->id, "s1");
 
-		if(time_before(current_time, last_interrupt_time_s1 + debounce_jiffies))
+	if(debounced(ktime_get(), &rd->last_interrupt_time_s1, debounce_us))
+	{
+		hrtimer_start(&rd->s1_settle_timer, us_to_ktime(settle_us), HRTIMER_MODE_REL);
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int rotary_get_pin(struct rotary_dev *rd, struct gpio_desc *desc)
+{
+	return rd->can_sleep ? gpiod_get_value_cansleep(desc) : gpiod_get_value(desc);
+}
+
+static void rotary_settle_sample(struct rotary_dev *rd)
+{
+	int val_s1 = rotary_get_pin(rd, rd->s1_gpio);
+	int val_s2 = rotary_get_pin(rd, rd->s2_gpio);
+	unsigned long flags;
+
+	if(val_s1 == 0)
+	{
+		int dir = (val_s2 == 1) ? 1 : -1;
+		int step = dir;
+		int position;
+		bool held;
+
+		spin_lock_irqsave(&rd->lock, flags);
+		held = rd->button_down;
+		if(held)
 		{
-			return IRQ_HANDLED;
+			// 누른 채 회전: LONG/CLICK 대신 HOLD_* 로 처리
+			rd->button_turned = true;
+			hrtimer_try_to_cancel(&rd->long_press_timer);
 		}
-		last_interrupt_time_s1 = current_time;
 
-		udelay(500);
-
-		int val_s1 = gpio_get_value(S1_GPIO);
-		int val_s2 = gpio_get_value(S2_GPIO);
+		if(accumulate)
+		{
+			step = add_detent(rd, dir, rd->last_interrupt_time_s1, held);
+		}
+		else if(held)
+		{
+			queue_event(rd, dir > 0 ? ROTARY_EV_HOLD_CW : ROTARY_EV_HOLD_CCW,
+						rd->last_interrupt_time_s1);
+		}
+		else
+		{
+			queue_event(rd, dir > 0 ? ROTARY_EV_CW : ROTARY_EV_CCW,
+						rd->last_interrupt_time_s1);
+		}
+		rd->position += step;
+		position = rd->position;
+		spin_unlock_irqrestore(&rd->lock, flags);
 
-		if(val_s1 == 0)
+		if(rd->id == 0)
 		{
-			if(val_s2 == 1)
-			{
-				add_event("CW\n");
-				printk(KERN_INFO "Rotary : CW\n");
-			}
-			else
-			{
-				add_event("CCW\n");
-				printk(KERN_INFO "Rotary : CCW\n");
-			}
+			sensorhub_publish_rotary(position, step, rd->last_interrupt_time_s1);
 		}
-		
-		return IRQ_HANDLED;
+		rotary_notify(rd);
+		dev_dbg(rd->dev, "Rotary : %s%s\n", held ? "HOLD_" : "", dir > 0 ? "CW" : "CCW");
+	}
 }
 
-static irqreturn_t button_handler(int irq, void *dev_id)
+static void rotary_settle_work(struct work_struct *work)
 {
-	unsigned long current_time = jiffies;
-	unsigned long debounce_jiffies = msecs_to_jiffies(50);
+	rotary_settle_sample(container_of(work, struct rotary_dev, s1_settle_work));
+}
 
-	if(time_before(current_time, last_interrupt_time_sw + debounce_jiffies))
+static enum hrtimer_restart rotary_settle(struct hrtimer *timer)
+{
+	struct rotary_dev *rd = container_of(timer, struct rotary_dev, s1_settle_timer);
+
+	if(rd->can_sleep)
+	{
+		schedule_work(&rd->s1_settle_work);
+	}
+	else
 	{
-		return IRQ_HANDLED;
+		rotary_settle_sample(rd);
 	}
-	last_interrupt_time_sw = current_time;
 
-	add_event("CLICK\n");
-	printk(KERN_INFO "Rotary : Click\n");
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * 버튼은 눌림/뗌 양쪽 에지에서 인터럽트가 걸린다. 에지가 올 때마다 타이머를
+ * 다시 걸어 button_debounce_us 동안 조용해진 뒤의 레벨만 받아들인다.
+ */
+static irqreturn_t button_handler(int irq, void *dev_id)
+{
+	struct rotary_dev *rd = dev_id;
+
+	trace_rotary_irq(rd->id, "sw");
+
+	rd->last_interrupt_time_sw = ktime_get();
+	hrtimer_start(&rd->sw_settle_timer, us_to_ktime(button_debounce_us), HRTIMER_MODE_REL);
 
 	return IRQ_HANDLED;
 }
 
+/* rd->lock 을 잡은 상태에서 호출 */
+static void button_released(struct rotary_dev *rd)
+{
+	if(rd->long_fired || rd->button_turned)
+	{
+		return;
+	}
+
+	if(rd->double_click_ms == 0)
+	{
+		queue_event(rd, ROTARY_EV_CLICK, rd->press_time);
+	}
+	else if(rd->click_pending)
+	{
+		hrtimer_try_to_cancel(&rd->double_click_timer);
+		rd->click_pending = false;
+		queue_event(rd, ROTARY_EV_DOUBLE, rd->press_time);
+	}
+	else
+	{
+		rd->click_pending = true;
+		rd->click_time = rd->press_time;
+		hrtimer_start(&rd->double_click_timer, ms_to_ktime(rd->double_click_ms),
+					  HRTIMER_MODE_REL);
+	}
+}
+
+static void button_settle_sample(struct rotary_dev *rd)
+{
+	bool pressed = (rotary_get_pin(rd, rd->sw_gpio) == 0);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	if(pressed && !rd->button_down)
+	{
+		rd->button_down = true;
+		rd->button_turned = false;
+		rd->long_fired = false;
+		rd->press_time = rd->last_interrupt_time_sw;
+		if(rd->long_press_ms)
+		{
+			hrtimer_start(&rd->long_press_timer, ms_to_ktime(rd->long_press_ms),
+						  HRTIMER_MODE_REL);
+		}
+	}
+	else if(!pressed && rd->button_down)
+	{
+		rd->button_down = false;
+		hrtimer_try_to_cancel(&rd->long_press_timer);
+		button_released(rd);
+	}
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	rotary_notify(rd);
+}
+
+static void button_settle_work(struct work_struct *work)
+{
+	button_settle_sample(container_of(work, struct rotary_dev, sw_settle_work));
+}
+
+static enum hrtimer_restart button_settle(struct hrtimer *timer)
+{
+	struct rotary_dev *rd = container_of(timer, struct rotary_dev, sw_settle_timer);
+
+	if(rd->can_sleep)
+	{
+		schedule_work(&rd->sw_settle_work);
+	}
+	else
+	{
+		button_settle_sample(rd);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+static enum hrtimer_restart long_press_expired(struct hrtimer *timer)
+{
+	struct rotary_dev *rd = container_of(timer, struct rotary_dev, long_press_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	if(rd->button_down && !rd->button_turned)
+	{
+		// 첫 번째 클릭 뒤 길게 누른 경우: 대기 중인 CLICK 을 먼저 보낸다
+		if(rd->click_pending)
+		{
+			hrtimer_try_to_cancel(&rd->double_click_timer);
+			rd->click_pending = false;
+			queue_event(rd, ROTARY_EV_CLICK, rd->click_time);
+		}
+		rd->long_fired = true;
+		queue_event(rd, ROTARY_EV_LONG, ktime_get());
+		dev_dbg(rd->dev, "Rotary : Long press\n");
+	}
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	rotary_notify(rd);
+
+	return HRTIMER_NORESTART;
+}
+
+static enum hrtimer_restart double_click_expired(struct hrtimer *timer)
+{
+	struct rotary_dev *rd = container_of(timer, struct rotary_dev, double_click_timer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	if(rd->click_pending)
+	{
+		rd->click_pending = false;
+		queue_event(rd, ROTARY_EV_CLICK, rd->click_time);
+	}
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	rotary_notify(rd);
+
+	return HRTIMER_NORESTART;
+}
+
+/* 큐에 쌓인 이벤트 우선, 없으면 누적된 회전량을 꺼낸다 */
+static bool pop_event(struct rotary_dev *rd, struct rotary_event *ev)
+{
+	unsigned long flags;
+	bool found = true;
+
+	spin_lock_irqsave(&rd->lock, flags);
+	if(rd->event_head != rd->event_tail)
+	{
+		*ev = rd->event_buffer[rd->event_tail];
+		rd->event_tail = (rd->event_tail + 1) % EVENT_BUF_SIZE;
+	}
+	else if(rd->acc_delta != 0)
+	{
+		ev->type = rd->acc_held ? ROTARY_EV_HOLD_DELTA : ROTARY_EV_DELTA;
+		ev->delta = rd->acc_delta;
+		ev->rate = rd->acc_rate;
+		ev->ts = rd->acc_ts;
+		rd->acc_delta = 0;
+	}
+	else
+	{
+		found = false;
+	}
+	spin_unlock_irqrestore(&rd->lock, flags);
+
+	if(found)
+	{
+		trace_rotary_dequeue(rd->id, event_names[ev->type], ev->delta, ev->ts);
+	}
+
+	return found;
+}
+
+static int rotary_open(struct inode *inode, struct file *file)
+{
+	file->private_data = container_of(inode->i_cdev, struct rotary_dev, cdev);
+	return 0;
+}
+
 static ssize_t rotary_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
 {
+	struct rotary_dev *rd = file->private_data;
+	struct rotary_event ev;
+	// 가장 긴 줄: "HOLD_DELTA -2147483648 4294967295 -9223372036854775808\n" (55 바이트)
+	char msg[64];
 	int len;
 
-	if(event_head == event_tail)
+	while(!pop_event(rd, &ev))
 	{
+		if(rotary_dead(rd))
+		{
+			return -ENODEV;
+		}
+
 		if(file->f_flags & O_NONBLOCK)
 		{
 			return -EAGAIN;
 		}
 
-		wait_event_interruptible(rotary_wait_queue, data_ready != 0);
-		data_ready = 0;
+		if(wait_event_interruptible(rd->wait_queue,
+									rotary_event_pending(rd) || rotary_dead(rd)))
+		{
+			return -ERESTARTSYS;
+		}
 	}
-	
-	len = strlen(event_buffer[event_tail]);
 
-	if(copy_to_user(buf, event_buffer[event_tail], len))
+	if(ev.type == ROTARY_EV_DELTA || ev.type == ROTARY_EV_HOLD_DELTA)
 	{
-		printk(KERN_ERR "ERROR : copy_to_user\n");
-		return -EFAULT;
+		len = scnprintf(msg, sizeof(msg), "%s %+d %u %lld\n",
+						event_names[ev.type], ev.delta, ev.rate, ktime_to_ns(ev.ts));
+	}
+	else
+	{
+		len = scnprintf(msg, sizeof(msg), "%s %lld\n",
+						event_names[ev.type], ktime_to_ns(ev.ts));
+	}
+
+	if(len > count)
+	{
+		len = count;
 	}
 
-	event_tail = (event_tail + 1) % EVENT_BUF_SIZE;
+	if(copy_to_user(buf, msg, len))
+	{
+		dev_err(&rd->chardev, "ERROR : copy_to_user\n");
+		return -EFAULT;
+	}
 
 	return len;
 }
 
+static __poll_t rotary_poll(struct file *file, poll_table *wait)
+{
+	struct rotary_dev *rd = file->private_data;
+
+	poll_wait(file, &rd->wait_queue, wait);
+
+	if(rotary_dead(rd))
+	{
+		return EPOLLHUP | EPOLLERR;
+	}
+
+	if(rotary_event_pending(rd))
+	{
+		return EPOLLIN | EPOLLRDNORM;
+	}
+
+	return 0;
+}
+
+static int rotary_fasync(int fd, struct file *file, int on)
+{
+	struct rotary_dev *rd = file->private_data;
+
+	return fasync_helper(fd, file, on, &rd->async_queue);
+}
+
+static int rotary_release(struct inode *inode, struct file *file)
+{
+	// SIGIO 수신 목록에서 제거
+	rotary_fasync(-1, file, 0);
+	return 0;
+}
+
+static ssize_t long_press_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rotary_dev *rd = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", rd->long_press_ms);
+}
+
+static ssize_t long_press_ms_store(struct device *dev, struct device_attribute *attr,
+								   const char *buf, size_t count)
+{
+	struct rotary_dev *rd = dev_get_drvdata(dev);
+	int ret = kstrtouint(buf, 10, &rd->long_press_ms);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(long_press_ms);
+
+static ssize_t double_click_ms_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct rotary_dev *rd = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", rd->double_click_ms);
+}
+
+static ssize_t double_click_ms_store(struct device *dev, struct device_attribute *attr,
+									 const char *buf, size_t count)
+{
+	struct rotary_dev *rd = dev_get_drvdata(dev);
+	int ret = kstrtouint(buf, 10, &rd->double_click_ms);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(double_click_ms);
+
+static struct attribute *rotary_attrs[] = {
+	&dev_attr_long_press_ms.attr,
+	&dev_attr_double_click_ms.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(rotary);
+
 static struct file_operations fops = {
 	.owner = THIS_MODULE,
-	.read = rotary_read
+	.open = rotary_open,
+	.read = rotary_read,
+	.poll = rotary_poll,
+	.fasync = rotary_fasync,
+	.release = rotary_release
 };
 
-static int __init rotary_init(void)
+static void rotary_init_timer(struct hrtimer *timer,
+							  enum hrtimer_restart (*fn)(struct hrtimer *))
 {
+	hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	timer->function = fn;
+}
+
+static void rotary_cancel_timers(struct rotary_dev *rd)
+{
+	hrtimer_cancel(&rd->s1_settle_timer);
+	hrtimer_cancel(&rd->sw_settle_timer);
+	// settle work 가 long_press 타이머를 걸 수 있으므로 그 타이머보다 먼저 멈춘다
+	cancel_work_sync(&rd->s1_settle_work);
+	cancel_work_sync(&rd->sw_settle_work);
+	hrtimer_cancel(&rd->long_press_timer);
+	hrtimer_cancel(&rd->double_click_timer);
+}
+
+/* 마지막 참조 (remove 와 마지막 close 중 늦은 쪽) 가 놓이면 호출된다 */
+static void rotary_dev_release(struct device *dev)
+{
+	struct rotary_dev *rd = container_of(dev, struct rotary_dev, chardev);
+
+	kfree(rd);
+}
+
+/* --- Platform Probe & Remove --- */
+
+static int rotary_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct rotary_dev *rd;
 	int ret;
-	printk(KERN_INFO "====== rotary initializeing ======\n");
-    ret = alloc_chrdev_region(&device_number, 0, 1, DEVICE_NAME);
-	if (ret == -1) 
+
+	rd = kzalloc(sizeof(*rd), GFP_KERNEL);
+	if (!rd) return -ENOMEM;
+
+	rd->id = ida_alloc_max(&rotary_ida, ROTARY_MAX_DEVICES - 1, GFP_KERNEL);
+	if (rd->id < 0)
 	{
-		printk(KERN_ERR "ERROR: alloc_chardev_regin ........\n");
-    	return ret;
+		ret = rd->id;
+		kfree(rd);
+		return ret;
 	}
 
-	cdev_init(&rotary_cdev, &fops);
-	if ((ret = cdev_add(&rotary_cdev, device_number, 1)) == -1)
+	rd->dev = dev;
+	rd->long_press_ms = DEFAULT_LONG_PRESS_MS;
+	spin_lock_init(&rd->lock);
+	init_waitqueue_head(&rd->wait_queue);
+	platform_set_drvdata(pdev, rd);
+
+	rotary_init_timer(&rd->s1_settle_timer, rotary_settle);
+	rotary_init_timer(&rd->sw_settle_timer, button_settle);
+	rotary_init_timer(&rd->long_press_timer, long_press_expired);
+	rotary_init_timer(&rd->double_click_timer, double_click_expired);
+	INIT_WORK(&rd->s1_settle_work, rotary_settle_work);
+	INIT_WORK(&rd->sw_settle_work, button_settle_work);
+
+	// 여기부터 rd 는 put_device(&rd->chardev) 로 해제한다
+	device_initialize(&rd->chardev);
+	rd->chardev.devt = MKDEV(MAJOR(device_number), rd->id);
+	rd->chardev.class = rotary_class;
+	rd->chardev.parent = dev;
+	rd->chardev.groups = rotary_groups;
+	rd->chardev.release = rotary_dev_release;
+	dev_set_drvdata(&rd->chardev, rd);
+
+	ret = dev_set_name(&rd->chardev, DEVICE_NAME "%d", rd->id);
+	if (ret)
+		goto err_put;
+
+	rd->s1_gpio = devm_gpiod_get(dev, "s1", GPIOD_IN);
+	if (IS_ERR(rd->s1_gpio))
 	{
-		printk(KERN_ERR "ERROR: cdev_add  ........\n");
-    	unregister_chrdev_region(device_number, 1);
-    	return ret;
+		ret = dev_err_probe(dev, PTR_ERR(rd->s1_gpio), "ERROR: s1-gpios\n");
+		goto err_put;
 	}
 
-	rotary_class = class_create(THIS_MODULE, DEVICE_NAME);
-	if (IS_ERR(rotary_class))
+	rd->s2_gpio = devm_gpiod_get(dev, "s2", GPIOD_IN);
+	if (IS_ERR(rd->s2_gpio))
+	{
+		ret = dev_err_probe(dev, PTR_ERR(rd->s2_gpio), "ERROR: s2-gpios\n");
+		goto err_put;
+	}
+
+	rd->sw_gpio = devm_gpiod_get(dev, "sw", GPIOD_IN);
+	if (IS_ERR(rd->sw_gpio))
 	{
-		cdev_del(&rotary_cdev);
-    	unregister_chrdev_region(device_number, 1);
-    	return PTR_ERR(rotary_class);
+		ret = dev_err_probe(dev, PTR_ERR(rd->sw_gpio), "ERROR: sw-gpios\n");
+		goto err_put;
 	}
-	device_create(rotary_class, NULL, device_number, NULL, DEVICE_NAME);
 
-	if (gpio_request(S1_GPIO, "my_rotary") ||
-		gpio_request(S2_GPIO, "my_rotary") ||
-		gpio_request(SW_GPIO, "my_rotary")) {
-		printk(KERN_ERR "ERROR: gpio_request  ........\n");
-		return -1;
+	rd->can_sleep = gpiod_cansleep(rd->s1_gpio) || gpiod_cansleep(rd->s2_gpio) ||
+					gpiod_cansleep(rd->sw_gpio);
+
+	rd->irq_s1 = gpiod_to_irq(rd->s1_gpio);
+	if (rd->irq_s1 < 0)
+	{
+		ret = rd->irq_s1;
+		goto err_put;
 	}
 
-	gpio_direction_input(S1_GPIO);
-  	gpio_direction_input(S2_GPIO);
-	gpio_direction_input(SW_GPIO);
+	rd->irq_sw = gpiod_to_irq(rd->sw_gpio);
+	if (rd->irq_sw < 0)
+	{
+		ret = rd->irq_sw;
+		goto err_put;
+	}
 
-	interrupt_num_s1 = gpio_to_irq(S1_GPIO);
-	ret = request_irq(interrupt_num_s1, rotary_handler, IRQF_TRIGGER_FALLING,
-					"my_rotary_irq_S1", NULL);
+	// cdev 가 chardev 를 부모로 잡으므로 열린 파일이 있는 동안 rd 가 남는다
+	cdev_init(&rd->cdev, &fops);
+	rd->cdev.owner = THIS_MODULE;
+	ret = cdev_device_add(&rd->cdev, &rd->chardev);
 	if (ret)
 	{
-    	printk(KERN_ERR "ERROR: request_irq_s1  ........\n");
-    	return -ret;
+		dev_err(dev, "ERROR: cdev_device_add  ........\n");
+		goto err_put;
 	}
 
-	interrupt_num_sw = gpio_to_irq(SW_GPIO);
-	ret = request_irq(interrupt_num_sw, button_handler, IRQF_TRIGGER_FALLING,
-					"my_rotary_irq_sw", NULL);
-	if(ret)
+	// rd 보다 먼저 풀어야 하므로 devm 이 아닌 request_irq 를 쓰고 remove 에서 직접 해제한다
+	ret = request_irq(rd->irq_s1, rotary_handler, IRQF_TRIGGER_FALLING, dev_name(dev), rd);
+	if (ret)
 	{
-		printk(KERN_ERR "ERROR : request_irq_sw .........\n");
-		return -ret;
+		dev_err(dev, "ERROR: request_irq_s1  ........\n");
+		goto err_cdev;
 	}
-	printk(KERN_INFO "rotary driver init success ........\n");
-  	return 0;
+
+	ret = request_irq(rd->irq_sw, button_handler, IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
+					  dev_name(dev), rd);
+	if (ret)
+	{
+		dev_err(dev, "ERROR : request_irq_sw .........\n");
+		goto err_irq_s1;
+	}
+
+	dev_info(dev, "rotary encoder ready: /dev/%s%d\n", DEVICE_NAME, rd->id);
+	return 0;
+
+err_irq_s1:
+	// irq_s1 은 이미 settle 타이머를 걸었을 수 있다
+	free_irq(rd->irq_s1, rd);
+	rotary_cancel_timers(rd);
+err_cdev:
+	cdev_device_del(&rd->cdev, &rd->chardev);
+err_put:
+	ida_free(&rotary_ida, rd->id);
+	put_device(&rd->chardev);
+	return ret;
+}
+
+static int rotary_remove(struct platform_device *pdev)
+{
+	struct rotary_dev *rd = platform_get_drvdata(pdev);
+	unsigned long flags;
+
+	// IRQ 를 먼저 풀어야 타이머가 다시 걸리지 않는다
+	free_irq(rd->irq_s1, rd);
+	free_irq(rd->irq_sw, rd);
+	rotary_cancel_timers(rd);
+
+	// 열린 파일은 rd 를 계속 참조한다: 대기 중인 reader 를 깨워 -ENODEV 로 끝낸다
+	spin_lock_irqsave(&rd->lock, flags);
+	rd->dead = true;
+	spin_unlock_irqrestore(&rd->lock, flags);
+	rotary_notify(rd);
+
+	cdev_device_del(&rd->cdev, &rd->chardev);
+	ida_free(&rotary_ida, rd->id);
+	put_device(&rd->chardev);
+
+	return 0;
 }
 
-static void __exit rotary_exit(void) 
+static const struct of_device_id rotary_dt_ids[] = {
+	{ .compatible = "smartclock,rotary" },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, rotary_dt_ids);
+
+static struct platform_driver rotary_driver = {
+	.driver = {
+		.name = "smartclock_rotary",
+		.of_match_table = rotary_dt_ids,
+	},
+	.probe = rotary_probe,
+	.remove = rotary_remove,
+};
+
+static int __init rotary_init(void)
 {
-  free_irq(interrupt_num_s1, NULL);
-  free_irq(interrupt_num_sw, NULL);
+	int ret;
+	printk(KERN_INFO "====== rotary initializeing ======\n");
+	ret = alloc_chrdev_region(&device_number, 0, ROTARY_MAX_DEVICES, DEVICE_NAME);
+	if (ret < 0)
+	{
+		printk(KERN_ERR "ERROR: alloc_chardev_regin ........\n");
+		return ret;
+	}
+
+	rotary_class = class_create(THIS_MODULE, DEVICE_NAME);
+	if (IS_ERR(rotary_class))
+	{
+		unregister_chrdev_region(device_number, ROTARY_MAX_DEVICES);
+		return PTR_ERR(rotary_class);
+	}
+
+	ret = platform_driver_register(&rotary_driver);
+	if (ret)
+	{
+		printk(KERN_ERR "ERROR: platform_driver_register ........\n");
+		class_destroy(rotary_class);
+		unregister_chrdev_region(device_number, ROTARY_MAX_DEVICES);
+		return ret;
+	}
 
-  gpio_free(S1_GPIO);
-  gpio_free(S2_GPIO);
-  gpio_free(SW_GPIO);
+	printk(KERN_INFO "rotary driver init success ........\n");
+	return 0;
+}
 
-  device_destroy(rotary_class, device_number);
-  class_destroy(rotary_class);
-  cdev_del(&rotary_cdev);
-  unregister_chrdev_region(device_number, 1);
+static void __exit rotary_exit(void)
+{
+	platform_driver_unregister(&rotary_driver);
+	class_destroy(rotary_class);
+	unregister_chrdev_region(device_number, ROTARY_MAX_DEVICES);
+	ida_destroy(&rotary_ida);
 
-  printk(KERN_INFO "rotary_driver_exit");
+	printk(KERN_INFO "rotary_driver_exit");
 }
 
 module_init(rotary_init);
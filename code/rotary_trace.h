@@ -0,0 +1,92 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM rotary
+
+#if !defined(_ROTARY_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _ROTARY_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/*
+ * 로터리 입력 경로 tracepoint (/sys/kernel/tracing/events/rotary/)
+ *   rotary_irq      : 하드 IRQ 진입 (line: "s1" 회전, "sw" 버튼)
+ *   rotary_enqueue  : 이벤트가 링에 들어감 (depth: 넣은 뒤 대기 중인 개수)
+ *   rotary_dequeue  : read() 가 꺼냄. wait_ns = 꺼낸 시각 - 에지 시각
+ */
+TRACE_EVENT(rotary_irq,
+
+	TP_PROTO(int id, const char *line),
+
+	TP_ARGS(id, line),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__string(line, line)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__assign_str(line, line);
+	),
+
+	TP_printk("rotary%d %s", __entry->id, __get_str(line))
+);
+
+TRACE_EVENT(rotary_enqueue,
+
+	TP_PROTO(int id, const char *type, int delta, ktime_t ts, int depth),
+
+	TP_ARGS(id, type, delta, ts, depth),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__string(type, type)
+		__field(int, delta)
+		__field(s64, ts)
+		__field(int, depth)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__assign_str(type, type);
+		__entry->delta = delta;
+		__entry->ts = ktime_to_ns(ts);
+		__entry->depth = depth;
+	),
+
+	TP_printk("rotary%d %s delta=%d ts=%lld depth=%d",
+			  __entry->id, __get_str(type), __entry->delta, __entry->ts, __entry->depth)
+);
+
+TRACE_EVENT(rotary_dequeue,
+
+	TP_PROTO(int id, const char *type, int delta, ktime_t ts),
+
+	TP_ARGS(id, type, delta, ts),
+
+	TP_STRUCT__entry(
+		__field(int, id)
+		__string(type, type)
+		__field(int, delta)
+		__field(s64, ts)
+		__field(s64, wait_ns)
+	),
+
+	TP_fast_assign(
+		__entry->id = id;
+		__assign_str(type, type);
+		__entry->delta = delta;
+		__entry->ts = ktime_to_ns(ts);
+		__entry->wait_ns = ktime_to_ns(ktime_sub(ktime_get(), ts));
+	),
+
+	TP_printk("rotary%d %s delta=%d ts=%lld wait_ns=%lld",
+			  __entry->id, __get_str(type), __entry->delta, __entry->ts, __entry->wait_ns)
+);
+
+#endif /* _ROTARY_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE rotary_trace
+#include <trace/define_trace.h>
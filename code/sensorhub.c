@@ -0,0 +1,390 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/fs.h>
+#include <linux/cdev.h>
+#include <linux/uaccess.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/io.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/rtc.h>
+#include <linux/debugfs.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+
+#include "sensorhub.h"
+
+#define DEVICE_NAME		"sensorhub"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Driver Developer");
+MODULE_DESCRIPTION("smart clock sensor hub");
+
+static dev_t device_number;
+static struct cdev hub_cdev;
+static struct class *hub_class = NULL;
+
+/*
+ * 레코드는 mmap 할 수 있도록 페이지 하나에 둔다. 드라이버들은 hrtimer/타이머 문맥에서도
+ * 값을 넣으므로 hub_lock 은 irqsave 스핀락이다. 쓰는 동안 seq 를 홀수로 만들어
+ * 잠금 없이 읽는 mmap 사용자도 일관된 값을 얻게 한다.
+ */
+static struct sensorhub_record *hub_rec;
+static DEFINE_SPINLOCK(hub_lock);
+static DECLARE_WAIT_QUEUE_HEAD(hub_wait);
+
+static struct dentry *hub_debugfs;
+
+/*
+ * 장치를 연 파일 수. mmap 은 파일 참조를 잡고 있으므로 munmap 할 때까지 사용자로 센다.
+ * 0 <-> 1 이 될 때 hub_notifier 로 알린다 (ds1302 틱, dht11 백그라운드 측정).
+ */
+static DEFINE_MUTEX(hub_users_lock);
+static int hub_users;
+static BLOCKING_NOTIFIER_HEAD(hub_notifier);
+
+// 파일마다 마지막으로 읽은 seq
+struct hub_file {
+	u32 seen_seq;
+};
+
+/* hub_lock 을 잡은 상태에서 호출 */
+static void hub_write_begin(void)
+{
+	WRITE_ONCE(hub_rec->seq, hub_rec->seq + 1);
+	smp_wmb();
+}
+
+/* hub_lock 을 잡은 상태에서 호출 */
+static void hub_write_end(void)
+{
+	smp_wmb();
+	WRITE_ONCE(hub_rec->seq, hub_rec->seq + 1);
+}
+
+void sensorhub_publish_time(const struct rtc_time *tm, bool valid)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hub_lock, flags);
+	hub_write_begin();
+	hub_rec->year = tm->tm_year + 1900;
+	hub_rec->month = tm->tm_mon + 1;
+	hub_rec->day = tm->tm_mday;
+	hub_rec->hour = tm->tm_hour;
+	hub_rec->minute = tm->tm_min;
+	hub_rec->second = tm->tm_sec;
+	hub_rec->time_valid = valid;
+	hub_rec->time_seq++;
+	hub_write_end();
+	spin_unlock_irqrestore(&hub_lock, flags);
+
+	wake_up_interruptible(&hub_wait);
+}
+EXPORT_SYMBOL_GPL(sensorhub_publish_time);
+
+/*
+ * 측정할 때마다 env_seq 를 올린다 (값이 같아도 새 샘플). 실패면 마지막 성공 값은
+ * 그대로 두고 env_errors 만 올린다.
+ */
+void sensorhub_publish_env(int temp, int humi, bool ok)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hub_lock, flags);
+	hub_write_begin();
+	if(ok)
+	{
+		hub_rec->temp = temp;
+		hub_rec->humi = humi;
+		hub_rec->env_valid = 1;
+	}
+	else
+	{
+		hub_rec->env_errors++;
+	}
+	hub_rec->env_seq++;
+	hub_write_end();
+	spin_unlock_irqrestore(&hub_lock, flags);
+
+	wake_up_interruptible(&hub_wait);
+}
+EXPORT_SYMBOL_GPL(sensorhub_publish_env);
+
+void sensorhub_publish_rotary(int position, int delta, ktime_t ts)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&hub_lock, flags);
+	hub_write_begin();
+	hub_rec->position = position;
+	hub_rec->delta = delta;
+	hub_rec->rotary_ts = ktime_to_ns(ts);
+	hub_rec->rotary_seq++;
+	hub_write_end();
+	spin_unlock_irqrestore(&hub_lock, flags);
+
+	wake_up_interruptible(&hub_wait);
+}
+EXPORT_SYMBOL_GPL(sensorhub_publish_rotary);
+
+int sensorhub_register_notifier(struct notifier_block *nb)
+{
+	int ret;
+
+	mutex_lock(&hub_users_lock);
+	ret = blocking_notifier_chain_register(&hub_notifier, nb);
+	if(ret == 0 && hub_users > 0)
+	{
+		nb->notifier_call(nb, SENSORHUB_ACTIVE, NULL);
+	}
+	mutex_unlock(&hub_users_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(sensorhub_register_notifier);
+
+void sensorhub_unregister_notifier(struct notifier_block *nb)
+{
+	mutex_lock(&hub_users_lock);
+	if(blocking_notifier_chain_unregister(&hub_notifier, nb) == 0 && hub_users > 0)
+	{
+		nb->notifier_call(nb, SENSORHUB_IDLE, NULL);
+	}
+	mutex_unlock(&hub_users_lock);
+}
+EXPORT_SYMBOL_GPL(sensorhub_unregister_notifier);
+
+static bool hub_changed(struct hub_file *hf)
+{
+	return READ_ONCE(hub_rec->seq) != hf->seen_seq;
+}
+
+static int hub_open(struct inode *inode, struct file *file)
+{
+	struct hub_file *hf;
+
+	hf = kzalloc(sizeof(*hf), GFP_KERNEL);
+	if(!hf)	return -ENOMEM;
+
+	// 완료된 seq 는 항상 짝수이므로 첫 read 는 바로 돌아온다
+	hf->seen_seq = 1;
+	file->private_data = hf;
+
+	mutex_lock(&hub_users_lock);
+	if(hub_users++ == 0)
+	{
+		blocking_notifier_call_chain(&hub_notifier, SENSORHUB_ACTIVE, NULL);
+	}
+	mutex_unlock(&hub_users_lock);
+
+	return 0;
+}
+
+static int hub_release(struct inode *inode, struct file *file)
+{
+	mutex_lock(&hub_users_lock);
+	if(--hub_users == 0)
+	{
+		blocking_notifier_call_chain(&hub_notifier, SENSORHUB_IDLE, NULL);
+	}
+	mutex_unlock(&hub_users_lock);
+
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t hub_read(struct file *file, char __user *buf, size_t len, loff_t *offset)
+{
+	struct hub_file *hf = file->private_data;
+	struct sensorhub_record rec;
+	unsigned long flags;
+
+	if(len < sizeof(rec))	return -EINVAL;
+
+	while(!hub_changed(hf))
+	{
+		if(file->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+
+		if(wait_event_interruptible(hub_wait, hub_changed(hf)))
+		{
+			return -ERESTARTSYS;
+		}
+	}
+
+	spin_lock_irqsave(&hub_lock, flags);
+	rec = *hub_rec;
+	spin_unlock_irqrestore(&hub_lock, flags);
+
+	hf->seen_seq = rec.seq;
+
+	if(copy_to_user(buf, &rec, sizeof(rec)))
+	{
+		return -EFAULT;
+	}
+
+	return sizeof(rec);
+}
+
+static __poll_t hub_poll(struct file *file, poll_table *wait)
+{
+	struct hub_file *hf = file->private_data;
+
+	poll_wait(file, &hub_wait, wait);
+
+	if(hub_changed(hf))
+	{
+		return EPOLLIN | EPOLLRDNORM;
+	}
+
+	return 0;
+}
+
+/* 레코드 페이지를 읽기 전용으로 매핑한다 */
+static int hub_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if(vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > PAGE_SIZE)
+	{
+		return -EINVAL;
+	}
+
+	if(vma->vm_flags & VM_WRITE)
+	{
+		return -EPERM;
+	}
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_pfn_range(vma, vma->vm_start, virt_to_phys(hub_rec) >> PAGE_SHIFT,
+						   vma->vm_end - vma->vm_start, vma->vm_page_prot);
+}
+
+static struct file_operations fops = {
+	.owner = THIS_MODULE,
+	.open = hub_open,
+	.release = hub_release,
+	.read = hub_read,
+	.poll = hub_poll,
+	.mmap = hub_mmap,
+};
+
+/*
+ * /sys/kernel/debug/sensorhub/inject : 센서 없이 값을 넣는다 (시뮬레이션, 벤치마크)
+ *   "env <temp> <humi>"  DHT11 측정 성공
+ *   "env fail"           DHT11 측정 실패
+ */
+static ssize_t hub_inject_write(struct file *file, const char __user *ubuf,
+								size_t len, loff_t *ppos)
+{
+	char cmd[32];
+	int temp, humi;
+
+	if(len > sizeof(cmd) - 1)	return -EINVAL;
+	if(copy_from_user(cmd, ubuf, len))	return -EFAULT;
+
+	cmd[len] = '\0';
+
+	if(sscanf(cmd, "env %d %d", &temp, &humi) == 2)
+	{
+		sensorhub_publish_env(temp, humi, true);
+	}
+	else if(strncmp(cmd, "env fail", 8) == 0)
+	{
+		sensorhub_publish_env(0, 0, false);
+	}
+	else
+	{
+		return -EINVAL;
+	}
+
+	return len;
+}
+
+static const struct file_operations hub_inject_fops = {
+	.owner = THIS_MODULE,
+	.write = hub_inject_write,
+	.llseek = noop_llseek,
+};
+
+static int __init sensorhub_init(void)
+{
+	struct device *dev;
+	int ret;
+
+	printk(KERN_INFO "====== sensorhub initializeing ======\n");
+
+	BUILD_BUG_ON(sizeof(struct sensorhub_record) > PAGE_SIZE);
+
+	hub_rec = (struct sensorhub_record *)get_zeroed_page(GFP_KERNEL);
+	if(!hub_rec)	return -ENOMEM;
+
+	hub_rec->version = SENSORHUB_VERSION;
+	hub_rec->size = sizeof(*hub_rec);
+
+	ret = alloc_chrdev_region(&device_number, 0, 1, DEVICE_NAME);
+	if(ret < 0)
+	{
+		printk(KERN_ERR "ERROR: alloc_chardev_regin ........\n");
+		goto err_page;
+	}
+
+	cdev_init(&hub_cdev, &fops);
+	ret = cdev_add(&hub_cdev, device_number, 1);
+	if(ret)
+	{
+		printk(KERN_ERR "ERROR: cdev_add  ........\n");
+		goto err_region;
+	}
+
+	hub_class = class_create(THIS_MODULE, DEVICE_NAME);
+	if(IS_ERR(hub_class))
+	{
+		ret = PTR_ERR(hub_class);
+		goto err_cdev;
+	}
+
+	dev = device_create(hub_class, NULL, device_number, NULL, DEVICE_NAME);
+	if(IS_ERR(dev))
+	{
+		ret = PTR_ERR(dev);
+		goto err_class;
+	}
+
+	hub_debugfs = debugfs_create_dir(DEVICE_NAME, NULL);
+	debugfs_create_file("inject", 0200, hub_debugfs, NULL, &hub_inject_fops);
+
+	printk(KERN_INFO "sensorhub init success ........\n");
+	return 0;
+
+err_class:
+	class_destroy(hub_class);
+err_cdev:
+	cdev_del(&hub_cdev);
+err_region:
+	unregister_chrdev_region(device_number, 1);
+err_page:
+	free_page((unsigned long)hub_rec);
+	return ret;
+}
+
+static void __exit sensorhub_exit(void)
+{
+	debugfs_remove_recursive(hub_debugfs);
+	device_destroy(hub_class, device_number);
+	class_destroy(hub_class);
+	cdev_del(&hub_cdev);
+	unregister_chrdev_region(device_number, 1);
+	free_page((unsigned long)hub_rec);
+
+	printk(KERN_INFO "sensorhub_exit");
+}
+
+module_init(sensorhub_init);
+module_exit(sensorhub_exit);
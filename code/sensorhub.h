@@ -0,0 +1,95 @@
+#ifndef SENSORHUB_H
+#define SENSORHUB_H
+
+#include <linux/types.h>
+
+/*
+ * /dev/sensorhub : RTC 시간, DHT11 측정값, 로터리 위치를 하나의 바이너리 레코드로 모은다.
+ * (sensorhub.c 가 장치를 만들고 ds1302/dht11/rotary 드라이버가 값을 넣는다)
+ *
+ *  - read()  : struct sensorhub_record 하나. 마지막 read 이후 바뀐 것이 없으면
+ *              다음 변경까지 잔다 (O_NONBLOCK 은 -EAGAIN). 첫 read 는 바로 돌아온다
+ *  - poll()  : 어느 필드든 바뀌면 EPOLLIN
+ *  - mmap()  : 읽기 전용 한 페이지. 레코드가 페이지 앞에 있고 seq 를 seqlock 으로 쓴다
+ *              (sensorhub_record_read())
+ *
+ * 필드별 *_seq 는 그 필드가 갱신될 때마다 (DHT11 은 측정마다) 1 씩 오르므로, 읽는 쪽은
+ * 이전 값과 비교해 바뀐 필드만 처리하면 된다. 레이아웃을 바꾸면 SENSORHUB_VERSION 을 올린다.
+ *
+ * ds1302/dht11/rotary 는 아래 sensorhub_* 심볼을 쓰므로 sensorhub.ko 를 먼저 올려야 한다
+ * (insmod 는 순서대로, modprobe 는 depmod 가 만든 의존성으로 알아서 올린다).
+ * 장치를 연 사용자가 없으면 드라이버들은 notifier 로 이를 알고 주기 작업을 멈춘다.
+ */
+#define SENSORHUB_DEVICE	"/dev/sensorhub"
+#define SENSORHUB_VERSION	1
+
+struct sensorhub_record {
+	__u16 version;
+	__u16 size;			// sizeof(struct sensorhub_record)
+	__u32 seq;			// 전체 갱신 횟수 x 2. 홀수면 쓰는 중
+	__u32 time_seq;
+	__u32 env_seq;
+	__u32 rotary_seq;
+
+	// DS1302 (초 경계마다)
+	__u16 year;			// 4 자리
+	__u8 month;			// 1~12
+	__u8 day;
+	__u8 hour;
+	__u8 minute;
+	__u8 second;
+	__u8 time_valid;	// 0: 발진 정지 등으로 시간 무효
+
+	// DHT11 (마지막 측정)
+	__s16 temp;
+	__u16 humi;
+	__u32 env_errors;	// 누적 측정 실패 횟수
+	__u8 env_valid;		// 0: 아직 성공한 측정이 없음
+	__u8 reserved[3];
+
+	// 로터리 (/dev/rotary0)
+	__s32 position;		// 누적 스텝 (CW +)
+	__s32 delta;		// 마지막 갱신의 스텝 (가속 적용)
+	__s64 rotary_ts;	// 마지막 회전 시각 (CLOCK_MONOTONIC, ns)
+} __attribute__((packed));
+
+#ifdef __KERNEL__
+
+struct rtc_time;
+struct notifier_block;
+
+// notifier 이벤트: 첫 open / 마지막 release
+#define SENSORHUB_ACTIVE	1
+#define SENSORHUB_IDLE		2
+
+/*
+ * 등록할 때 이미 사용자가 있으면 바로 SENSORHUB_ACTIVE 를, 해제할 때 사용자가 있으면
+ * SENSORHUB_IDLE 을 보내므로 콜백은 항상 ACTIVE/IDLE 이 번갈아 온다. 프로세스 문맥.
+ */
+int sensorhub_register_notifier(struct notifier_block *nb);
+void sensorhub_unregister_notifier(struct notifier_block *nb);
+
+void sensorhub_publish_time(const struct rtc_time *tm, bool valid);
+void sensorhub_publish_env(int temp, int humi, bool ok);
+void sensorhub_publish_rotary(int position, int delta, ktime_t ts);
+
+#else
+
+// mmap 한 레코드에서 일관된 복사본을 얻는다 (시스템 콜 없음). 그때의 seq 를 돌려준다
+static inline __u32 sensorhub_record_read(const struct sensorhub_record *map,
+										  struct sensorhub_record *out)
+{
+	__u32 seq;
+
+	do {
+		seq = __atomic_load_n(&map->seq, __ATOMIC_ACQUIRE);
+		__builtin_memcpy(out, map, sizeof(*out));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || seq != __atomic_load_n(&map->seq, __ATOMIC_RELAXED));
+
+	return seq;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SENSORLOG_H
+#define SENSORLOG_H
+
+#include <stdint.h>
+
+/*
+ * 온습도 로그 파일 (app.c 가 쓰고 logread 가 읽는다)
+ *
+ *   [0, 4096)            헤더 (한 페이지)
+ *   [4096, ...)          레코드 capacity 개의 링 버퍼
+ *
+ * 파일은 처음 만들 때 전체 크기로 미리 할당하고 mmap 으로 쓴다.
+ * 레코드는 구간(segment) 안에서 시간 순으로 쌓이므로 읽는 쪽은 구간마다 이진 탐색한다.
+ * RTC 가 뒤로 맞춰지면 새 구간을 시작한다. 구간 번호는 링에서 오래된 것부터 1 씩만 늘어난다
+ * (segment 가 없던 파일은 0 으로 채워져 있으므로 하나의 구간으로 읽힌다).
+ */
+#define SENSORLOG_MAGIC         "SCLG"
+#define SENSORLOG_VERSION       1
+#define SENSORLOG_DATA_OFFSET   4096
+
+// 레코드 플래그
+#define SENSORLOG_F_TIME_VALID  0x0001  // time 이 유효한 DS1302 시각임
+#define SENSORLOG_F_READ_ERROR  0x0002  // DHT11 읽기 실패 (temp/humi 무효)
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t capacity;      // 레코드 슬롯 수
+    uint32_t head;          // 다음에 쓸 슬롯
+    uint64_t count;         // 지금까지 쓴 레코드 수 (capacity 를 넘으면 오래된 것부터 덮어씀)
+    uint32_t segment;       // 지금 쓰는 구간 (RTC 가 뒤로 맞춰질 때마다 +1)
+} sensorlog_header_t;
+
+typedef struct {
+    int64_t time;           // DS1302 시각 (로컬 시간으로 본 unix time, 초). 구간 안에서 직전 레코드 이상
+    int16_t temp;
+    uint16_t humi;
+    uint16_t flags;
+    uint16_t segment;       // 쓸 때의 header.segment (하위 16 비트)
+} sensorlog_record_t;
+
+// 파일 전체 크기
+static inline uint64_t sensorlog_file_size(uint32_t capacity)
+{
+    return SENSORLOG_DATA_OFFSET + (uint64_t)capacity * sizeof(sensorlog_record_t);
+}
+
+// 저장된 레코드 수
+static inline uint32_t sensorlog_used(const sensorlog_header_t* h)
+{
+    return h->count < h->capacity ? (uint32_t)h->count : h->capacity;
+}
+
+// 가장 오래된 것부터 i 번째 레코드의 슬롯
+static inline uint32_t sensorlog_slot(const sensorlog_header_t* h, uint32_t i)
+{
+    uint32_t oldest = h->count < h->capacity ? 0 : h->head;
+    return (uint32_t)(((uint64_t)oldest + i) % h->capacity);
+}
+
+// 가장 오래된 레코드의 구간 기준으로 센 구간 순서 (링 안에서 단조 증가)
+static inline uint16_t sensorlog_seg_order(const sensorlog_record_t* r, const sensorlog_record_t* oldest)
+{
+    return (uint16_t)(r->segment - oldest->segment);
+}
+
+#endif
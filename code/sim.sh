@@ -0,0 +1,111 @@
+#!/bin/sh
+#
+# 하드웨어 없이 드라이버와 app 을 돌리는 시뮬레이션 (root 권한, 일반 리눅스 VM)
+#
+#   ./sim.sh up                 gpio-sim 칩 + i2c-stub 를 만들고 모듈을 올린다
+#   ./sim.sh down               모두 내린다
+#   ./sim.sh bench [옵션...]    up 상태에서 app 을 띄우고 bench 로 지연을 잰다
+#                               (옵션은 bench 로 전달: ./bench --help)
+#
+# 구성
+#   - rotary, ds1302 : gpio-sim 라인 (smartclock_sim.ko 가 lookup 테이블로 연결)
+#                      엔코더는 bench 가 라인의 pull 을 바꿔 에지를 만든다.
+#                      DS1302 IO 는 pull-down 이라 모두 0 을 읽고, 드라이버는 이를 무효한 날짜로
+#                      보고 시간 무효를 알린다 (app 은 ---- 표시, 초 틱은 정상 동작)
+#   - oled           : i2c-stub 의 0x3c 에 ssd1306 클라이언트. i2c-stub 는 SMBus 전용이라
+#                      I2C 전송은 바로 거절되고, 보낸 바이트 수는 oled tracepoint 로 센다
+#   - dht11          : 올리지 않는다. 40 비트 파형은 인터럽트를 막은 us 단위 폴링이라
+#                      gpio-sim 으로 흉내 낼 수 없으므로 /sys/kernel/debug/sensorhub/inject
+#                      로 측정값을 넣는다
+#
+# 필요 커널 설정: CONFIG_GPIO_SIM, CONFIG_I2C_STUB, CONFIG_CONFIGFS_FS, CONFIG_FTRACE
+
+set -e
+cd "$(dirname "$0")"
+
+CFG=/sys/kernel/config/gpio-sim/smartclock
+LABEL=smartclock-sim
+LINES="rotary-s1 rotary-s2 rotary-sw ds1302-clk ds1302-io ds1302-ce"
+MODULES="sensorhub ds1302 rotary oled smartclock_sim"
+
+gpio_dir() {
+	echo /sys/devices/platform/$(cat $CFG/dev_name)/$(cat $CFG/bank0/chip_name)
+}
+
+i2c_stub_bus() {
+	grep -l "SMBus stub driver" /sys/bus/i2c/devices/i2c-*/name | head -n 1 | xargs dirname
+}
+
+up() {
+	modprobe gpio-sim
+	modprobe i2c-stub chip_addr=0x3c
+	mountpoint -q /sys/kernel/config || mount -t configfs none /sys/kernel/config
+
+	if [ ! -d $CFG ]; then
+		mkdir $CFG
+		mkdir $CFG/bank0
+		echo 6 > $CFG/bank0/num_lines
+		echo $LABEL > $CFG/bank0/label
+		i=0
+		for name in $LINES; do
+			mkdir $CFG/bank0/line$i
+			echo $name > $CFG/bank0/line$i/name
+			i=$((i + 1))
+		done
+		echo 1 > $CFG/live
+	fi
+
+	# 엔코더 idle: S1/SW 는 풀업 (S1 하강 에지가 회전, SW low 가 눌림)
+	echo pull-up > $(gpio_dir)/sim_gpio0/pull
+	echo pull-up > $(gpio_dir)/sim_gpio2/pull
+
+	for m in $MODULES; do
+		lsmod | grep -q "^$m " || insmod ./$m.ko
+	done
+
+	bus=$(i2c_stub_bus)
+	[ -e $bus/$(basename $bus | sed 's/i2c-//')-003c ] || echo ssd1306 0x3c > $bus/new_device
+
+	echo "gpio-sim : $(gpio_dir)"
+	echo "i2c-stub : $bus"
+	ls -l /dev/ds1302 /dev/rotary0 /dev/oled /dev/sensorhub
+}
+
+down() {
+	bus=$(i2c_stub_bus 2>/dev/null || true)
+	[ -n "$bus" ] && echo 0x3c > $bus/delete_device 2>/dev/null || true
+
+	for m in smartclock_sim oled rotary ds1302 sensorhub; do
+		lsmod | grep -q "^$m " && rmmod $m
+	done
+
+	if [ -d $CFG ]; then
+		echo 0 > $CFG/live
+		for i in 0 1 2 3 4 5; do
+			rmdir $CFG/bank0/line$i
+		done
+		rmdir $CFG/bank0
+		rmdir $CFG
+	fi
+
+	rmmod i2c-stub 2>/dev/null || true
+}
+
+case "$1" in
+	up)
+		up
+		;;
+	down)
+		down
+		;;
+	bench)
+		shift
+		./bench --gpio-dir=$(gpio_dir) "$@" -- \
+			./app --event-loop --no-shm \
+			--metrics=/tmp/smartclock-sim.sock --log=/tmp/smartclock-sim.log
+		;;
+	*)
+		echo "usage: $0 up|down|bench [bench options]"
+		exit 1
+		;;
+esac
@@ -0,0 +1,73 @@
+#ifndef SMARTCLOCK_SHM_H
+#define SMARTCLOCK_SHM_H
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/*
+ * app.c 가 최신 값을 게시하는 POSIX 공유 메모리 (/dev/shm/smartclock)
+ *
+ * 읽는 쪽은 shm_open(O_RDONLY) + mmap(PROT_READ, MAP_SHARED) 후
+ * smartclock_shm_read() 로 시스템 콜 없이 일관된 값을 얻는다. 변화를 기다리려면
+ * smartclock_shm_wait() 를 쓴다 (seq 를 futex 워드로 사용, 읽기 전용 매핑에서도 동작).
+ *
+ * 호환성: version 이 다르면 읽지 않는다. 같은 version 에서 필드를 뒤에 추가할 때는
+ * reading_size 만 늘리므로, 읽는 쪽은 자기가 아는 크기만큼만 복사한다.
+ */
+#define SMARTCLOCK_SHM_NAME     "/smartclock"
+#define SMARTCLOCK_SHM_MAGIC    0x4b434d53      // "SMCK"
+#define SMARTCLOCK_SHM_VERSION  1
+
+typedef struct {
+    uint64_t update_ns;     // 마지막 갱신 (CLOCK_MONOTONIC)
+    int32_t time_valid;
+    int32_t year;           // 4 자리
+    int32_t month;
+    int32_t day;
+    int32_t hour;
+    int32_t minute;
+    int32_t second;
+    int32_t temp;           // -1: 아직 없음
+    int32_t humi;
+} smartclock_reading_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reading_size;  // sizeof(smartclock_reading_t) (쓰는 쪽 기준)
+    uint32_t seq;           // seqlock, 홀수면 쓰는 중. futex 워드로도 쓴다
+    uint32_t reserved;
+    smartclock_reading_t reading;
+} smartclock_shm_t;
+
+static inline int smartclock_shm_valid(const smartclock_shm_t* shm)
+{
+    return shm->magic == SMARTCLOCK_SHM_MAGIC && shm->version == SMARTCLOCK_SHM_VERSION;
+}
+
+// 일관된 복사본과 그때의 seq 를 돌려준다
+static inline uint32_t smartclock_shm_read(const smartclock_shm_t* shm, smartclock_reading_t* out)
+{
+    size_t size = shm->reading_size < sizeof(*out) ? shm->reading_size : sizeof(*out);
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        __builtin_memcpy(out, &shm->reading, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&shm->seq, __ATOMIC_RELAXED));
+
+    return seq;
+}
+
+// seq 가 last_seq 에서 바뀔 때까지 (또는 timeout) 잔다. timeout 이 NULL 이면 무한
+static inline void smartclock_shm_wait(const smartclock_shm_t* shm, uint32_t last_seq,
+                                       const struct timespec* timeout)
+{
+    syscall(SYS_futex, &shm->seq, FUTEX_WAIT, last_seq, timeout, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/platform_device.h>
+#include <linux/gpio/machine.h>
+
+/*
+ * 하드웨어 없는 시뮬레이션용 보드 파일. 디바이스 트리 대신 gpio-sim 칩의 라인을
+ * GPIO lookup 테이블로 연결하고 rotary / ds1302 플랫폼 장치를 등록한다.
+ * gpio-sim 칩은 sim.sh 가 configfs 로 만든다 (label = SIM_CHIP_LABEL).
+ *
+ * 라인 번호 (sim.sh 와 bench.c 가 같은 번호를 쓴다)
+ *   0: rotary S1   1: rotary S2   2: rotary SW
+ *   3: DS1302 CLK  4: DS1302 IO   5: DS1302 CE
+ */
+#define SIM_CHIP_LABEL		"smartclock-sim"
+
+#define SIM_ROTARY_S1		0
+#define SIM_ROTARY_S2		1
+#define SIM_ROTARY_SW		2
+#define SIM_DS1302_CLK		3
+#define SIM_DS1302_IO		4
+#define SIM_DS1302_CE		5
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Driver Developer");
+MODULE_DESCRIPTION("smart clock gpio-sim board");
+
+static struct gpiod_lookup_table rotary_gpios = {
+	.dev_id = "smartclock_rotary",
+	.table = {
+		GPIO_LOOKUP(SIM_CHIP_LABEL, SIM_ROTARY_S1, "s1", GPIO_ACTIVE_HIGH),
+		GPIO_LOOKUP(SIM_CHIP_LABEL, SIM_ROTARY_S2, "s2", GPIO_ACTIVE_HIGH),
+		GPIO_LOOKUP(SIM_CHIP_LABEL, SIM_ROTARY_SW, "sw", GPIO_ACTIVE_HIGH),
+		{ }
+	},
+};
+
+static struct gpiod_lookup_table ds1302_gpios = {
+	.dev_id = "ds1302_rtc",
+	.table = {
+		GPIO_LOOKUP_IDX(SIM_CHIP_LABEL, SIM_DS1302_CLK, "bus", 0, GPIO_ACTIVE_HIGH),
+		GPIO_LOOKUP_IDX(SIM_CHIP_LABEL, SIM_DS1302_IO, "bus", 1, GPIO_ACTIVE_HIGH),
+		GPIO_LOOKUP(SIM_CHIP_LABEL, SIM_DS1302_CE, "ce", GPIO_ACTIVE_HIGH),
+		{ }
+	},
+};
+
+static struct platform_device *rotary_pdev;
+static struct platform_device *ds1302_pdev;
+
+static int __init smartclock_sim_init(void)
+{
+	int ret;
+
+	gpiod_add_lookup_table(&rotary_gpios);
+	gpiod_add_lookup_table(&ds1302_gpios);
+
+	rotary_pdev = platform_device_register_simple("smartclock_rotary", PLATFORM_DEVID_NONE, NULL, 0);
+	if(IS_ERR(rotary_pdev))
+	{
+		ret = PTR_ERR(rotary_pdev);
+		goto err_table;
+	}
+
+	ds1302_pdev = platform_device_register_simple("ds1302_rtc", PLATFORM_DEVID_NONE, NULL, 0);
+	if(IS_ERR(ds1302_pdev))
+	{
+		ret = PTR_ERR(ds1302_pdev);
+		goto err_rotary;
+	}
+
+	printk(KERN_INFO "smartclock sim board ready (%s)\n", SIM_CHIP_LABEL);
+	return 0;
+
+err_rotary:
+	platform_device_unregister(rotary_pdev);
+err_table:
+	gpiod_remove_lookup_table(&ds1302_gpios);
+	gpiod_remove_lookup_table(&rotary_gpios);
+	return ret;
+}
+
+static void __exit smartclock_sim_exit(void)
+{
+	platform_device_unregister(ds1302_pdev);
+	platform_device_unregister(rotary_pdev);
+	gpiod_remove_lookup_table(&ds1302_gpios);
+	gpiod_remove_lookup_table(&rotary_gpios);
+}
+
+module_init(smartclock_sim_init);
+module_exit(smartclock_sim_exit);